@@ -19,7 +19,9 @@
 // Switch 2: 2.3
 // LEDS: 3.0-3
 // ALARM: 3.4
-// UART: 4.3
+// UART TX: 4.3
+// UART RX: 4.2
+// TRIP COMPARATOR: 1.1 (jumper to 1.4)
 //--------------------------------------------------------------------
 
 #include <msp430.h> 
@@ -34,53 +36,598 @@ int fspin = 51;
 char message1[] = "\n\r Motor moved forward 36 degrees. \r\n";
 char message2[] = "\n\r Motor reversed 1 rotation. \r\n";
 
-// -- Update with rotation speed:
-// 50 rpm for 51 steps, width of 25.53 ms
-int fspeed = 24500;
-// 25 rpm for 513 steps, width of 4.68 ms
-int rspeed = 4900;
+// -- Update with rotation speed (rpm) and ramp acceleration (steps/s^2):
+// moves speed up from rest to this rpm and slow back down before the last step,
+// so the cruise speed can go past the 25 rpm the motor could start at directly
+int frpm = 5;
+int rrpm = 25;
+unsigned int accel = 400;
+
+// -- Update with soft travel limits, in half steps from the power up position (1026 = 1 rotation):
+// forward (feed) counts up, reverse (retract) counts down, the step engine
+// will not take a step past either one
+long posMin = -1026;
+long posMax = 5130;
+
+// -- Update with step mode: STEP_WAVE (one coil), STEP_FULL (two coils) or STEP_HALF
+// (s0, s1 or s2 over UART changes it while running)
+#define STEP_WAVE 0
+#define STEP_FULL 1
+#define STEP_HALF 2
+int stepMode = STEP_WAVE;
+
+// -- Update with rolling average window, 2^ADC_SHIFT samples (3 = 8, 4 = 16, 5 = 32, 6 = 64):
+#ifndef ADC_SHIFT                         // sim/windows builds it for each
+#define ADC_SHIFT 4
+#endif
+#define ADC_WINDOW (1 << ADC_SHIFT)
+
+// -- Update with pressure filter chain, run in order on every sample before adcStatus():
+// FILTER_AVERAGE (rolling average), FILTER_MEDIAN (spike rejection), FILTER_EMA,
+// FILTER_IIR1 (first order low pass), FILTER_IIR2 (second order low pass), FILTER_NONE
+// use each filter at most once, they keep their own state
+#define FILTER_NONE 0
+#define FILTER_AVERAGE 1
+#define FILTER_MEDIAN 2
+#define FILTER_EMA 3
+#define FILTER_IIR1 4
+#define FILTER_IIR2 5
+#define FILTER_STAGES 3
+int Filter_Chain[FILTER_STAGES] = {FILTER_MEDIAN, FILTER_EMA, FILTER_NONE};
+
+// -- Update with pressure zones in lb, LB() makes them Q8 when compiling:
+// a zone is entered once the force reaches its enter level and left once the
+// force drops under its exit level, the gap keeps noise from flipping zones
+// safe (green), warning (both off), unsafe (red, time stamped), cutoff (alarm, no feeding)
+#define LB(x) ((unsigned int)((x)*256))
+#define ZONE_SAFE 0
+#define ZONE_WARNING 1
+#define ZONE_UNSAFE 2
+#define ZONE_CUTOFF 3
+#define ZONE_COUNT 4
+const unsigned int Zone_Enter_Lb[ZONE_COUNT] = {LB(0), LB(29.30), LB(39.65), LB(50.0)};
+const unsigned int Zone_Exit_Lb[ZONE_COUNT] = {LB(0), LB(28.32), LB(38.28), LB(47.27)};
+
+// -- Update with hardware trip level in lb, LB() makes it Q8 when compiling:
+// eCOMP0 compares P1.1 (jumpered to the pressure input) with its 6-bit DAC and
+// cuts the coils from its own interrupt, no filter in the way. The DAC steps
+// are 64 counts so it trips at this level or up to one step over.
+#define TRIP_LEVEL LB(50.0)
+
+// -- Update with raw capture, send 'a' over UART to arm it:
+// triggers when a raw sample rises through CAP_LEVEL lb, keeps CAP_PRE samples
+// from before the trigger, stores every CAP_DIVIDE-th sample (1 = every sample)
+#define CAP_LEVEL LB(40.0)
+#define CAP_PRE 512
+#define CAP_DIVIDE 1
+
+// -- Update with status frame period in ms, 0 for none:
+#define TELEMETRY_MS 100
+
+// -- Update with pressure sample rate in Hz, 16 to 10000:
+// TB1 triggers the ADC on its own, so it holds at any motor speed
+#define SAMPLE_HZ 1000
+
+// -- Update with CPU clock in MHz (8, 16 or 24) and UART baud rate:
+// the UART, I2C, timer and ADC dividers are all worked out from these
+#ifndef MCLK_MHZ                          // sim/clocks builds it for each
+#define MCLK_MHZ 24
+#endif
+#define BAUD 115200
+
+// -- Update with PROFILE 1 to time every ISR and handler, 0 to build without the timing code
+// send 'p' over UART for a report, 'r' to reset the numbers
+#define PROFILE 1
 
 // Declare Variables/Subroutines:
 
+// Hardware Access
+// The control code below reaches pins and peripherals only through these.
+// init() and the ISRs are the MSP430 side, another target only has to
+// supply these plus its own init and interrupt sources. sim/ builds this
+// file for Linux against a modelled FR2355, see sim/Makefile.
+#define HAL_COILS(pattern)      (P3OUT = (P3OUT & ~COILS) | (pattern))
+#define HAL_STEP_PERIOD(count)  (TB3CCR0 += (count))
+#define HAL_ALARM(on)           ((on) ? (P3OUT |= BIT4) : (P3OUT &= ~BIT4))
+#define HAL_RED_LED(on)         ((on) ? (P1OUT |= BIT0) : (P1OUT &= ~BIT0))
+#define HAL_GREEN_LED(on)       ((on) ? (P6OUT |= BIT6) : (P6OUT &= ~BIT6))
+#define HAL_SW1()               ((P4IN & BIT1) == 0)    // pulled up, low when pressed
+#define HAL_SW2()               ((P2IN & BIT3) == 0)
+#define HAL_UART_START()        (UCA1IE |= UCTXIE)
+#define HAL_TRIP_LEVEL(code)    (CP0DACDATA = ((code) << 8) | (code), CP0INT &= ~CPIFG)
+#define HAL_I2C_WRITE()         (UCB1CTLW0 |= UCTR | UCTXSTT)
+#define HAL_I2C_READ()          (UCB1CTLW0 &= ~UCTR, UCB1CTLW0 |= UCTXSTT)
+#define HAL_I2C_STOP()          (UCB1CTLW0 |= UCTXSTP)
+#define HAL_I2C_TIMEOUT(count)  (TB3CCR3 = TB3R + (count), TB3CCTL3 &= ~CCIFG, TB3CCTL3 |= CCIE)
+#define HAL_I2C_TIMEOUT_OFF()   (TB3CCTL3 &= ~CCIE)
+#define HAL_I2C_STOP_AT(count)  (TB3CCR4 = TB3R + (count), TB3CCTL4 &= ~CCIFG, TB3CCTL4 |= CCIE)
+#define HAL_I2C_STOP_AT_OFF()   (TB3CCTL4 &= ~CCIE)
+#define HAL_I2C_STARTING()      ((UCB1CTLW0 & UCTXSTT) != 0)    // address still going out
+#define HAL_I2C_ADDRESS(addr)   (UCB1I2CSA = (addr))
+#define HAL_CRC_START(seed)     (CRCINIRES = (seed))
+#define HAL_CRC_BYTE(byte)      (CRCDIRB_L = (byte))
+#define HAL_CRC_RESULT()        (CRCINIRES)
+#define HAL_FRAM_OPEN()         (SYSCFG0 = FRWPPW | DFWP)           // program FRAM writable
+#define HAL_FRAM_CLOSE()        (SYSCFG0 = FRWPPW | PFWP | DFWP)
+#define HAL_FRAM_STATE()        (SYSCFG0 & (PFWP | DFWP))
+#define HAL_FRAM_RESTORE(state) (SYSCFG0 = FRWPPW | (state))
+#define HAL_PROF_TIME()         (TB2R)
+
+// Clock System
+// the DCO runs at MCLK_MHZ locked to REFO (32768 Hz) by the FLL, MCLK and
+// SMCLK both use it. TB1 and TB3 divide it back down to TIMER_HZ so step
+// periods and deadlines keep their units, TB2 counts it undivided for the
+// profiler, the ADC divides it to 5 MHz or less.
+#define MCLK_HZ (MCLK_MHZ * 1000000UL)
+#define TIMER_HZ 1000000UL               // TB1 and TB3 count this
+#if MCLK_MHZ == 8
+#define CLK_DCORSEL DCORSEL_3            // 8 MHz range
+#define CLK_NWAITS NWAITS_0              // FRAM wait states, none up to 8 MHz
+#define CLK_TBIDEX TBIDEX_0              // timers /8 /1
+#define CLK_TBDIV 8
+#define CLK_ADCDIV ADCDIV_1              // adc /2, 4 MHz
+#define CLK_ADCDIV_N 2
+#elif MCLK_MHZ == 16
+#define CLK_DCORSEL DCORSEL_5            // 16 MHz range
+#define CLK_NWAITS NWAITS_1              // one wait state up to 16 MHz
+#define CLK_TBIDEX TBIDEX_1              // timers /8 /2
+#define CLK_TBDIV 16
+#define CLK_ADCDIV ADCDIV_3              // adc /4, 4 MHz
+#define CLK_ADCDIV_N 4
+#elif MCLK_MHZ == 24
+#define CLK_DCORSEL DCORSEL_7            // 24 MHz range
+#define CLK_NWAITS NWAITS_2              // two wait states up to 24 MHz
+#define CLK_TBIDEX TBIDEX_2              // timers /8 /3
+#define CLK_TBDIV 24
+#define CLK_ADCDIV ADCDIV_4              // adc /5, 4.8 MHz
+#define CLK_ADCDIV_N 5
+#else
+#error "MCLK_MHZ has to be 8, 16 or 24"
+#endif
+#define CLK_FLLN (MCLK_HZ / 32768 - 1)   // DCOCLKDIV = 32768 * (FLLN+1)
+
+// UART divider, oversampling: UCBR whole 16ths, UCBRF the 16th left over,
+// UCBRS from the fraction of MCLK/BAUD (looked up at start up)
+#define UART_N (MCLK_HZ / BAUD)
+#define UART_BR (UART_N / 16)
+#define UART_BRF (UART_N - 16*UART_BR)
+#define UART_FRAC ((MCLK_HZ % BAUD) * 10000ULL / BAUD)     // 1/10000ths
+#ifndef I2C_HZ                            // sim/i2c builds it at 100 kHz as well
+#define I2C_HZ 400000UL                  // fast mode, the RTC takes up to 400 kHz
+#endif
+
+#if MCLK_HZ / (CLK_TBDIV * TIMER_HZ) != 1 || MCLK_HZ % (CLK_TBDIV * TIMER_HZ) != 0
+#error "timer divider doesn't give TIMER_HZ"
+#endif
+#if MCLK_HZ / CLK_ADCDIV_N > 5000000
+#error "ADC clock over 5 MHz"
+#endif
+#if MCLK_HZ / BAUD < 16
+#error "BAUD too high for MCLK_MHZ, the UART needs 16 clocks a bit"
+#endif
+#if MCLK_HZ / I2C_HZ > 0xFFFF || MCLK_HZ % I2C_HZ != 0
+#error "I2C divider doesn't give I2C_HZ"
+#endif
+
 // I/O Variables
+// ADC Variables
+// TB1.1 triggers each conversion in hardware and ADC_ISR drops the result into a block,
+// the main loop gets one EV_ADC per full block instead of one per sample
+#define ADC_BLOCK 8                       // samples per block
+#define ADC_BLOCKS 4                      // blocks in the ring, power of two
+#define SAMPLE_PERIOD (TIMER_HZ / SAMPLE_HZ)  // TB1 counts between conversions
+#if SAMPLE_HZ < 16 || SAMPLE_HZ > 10000
+#error "SAMPLE_HZ out of range, TB1 is 16 bits and a conversion takes about 30 us"
+#endif
+unsigned int ADC_Block[ADC_BLOCKS][ADC_BLOCK];
+volatile unsigned int adcFill = 0;        // next slot in the block being filled
+volatile unsigned int adcWrite = 0;       // block being filled
+volatile unsigned int adcQueued = 0;      // blocks posted but not yet processed
+volatile unsigned int adcOverrun = 0;     // blocks overwritten before main got to them
 unsigned int ADC_Value;
 unsigned int AVE_Value;
-unsigned int ADC_Values[20];
+
+// Calibration Variables
+// counts to lb is a straight line through two calibration points kept in
+// FRAM, lb are Q8 (1/256 lb, up to 255 lb). calInit() turns the thresholds
+// into counts once, so adcStatus() never converts, and the slope is kept
+// as a Q12 gain so countsToLb() is a multiply and a shift.
+typedef struct {
+    unsigned int count0;                  // low point, counts and Q8 lb
+    unsigned int lb0;
+    unsigned int count1;                  // high point
+    unsigned int lb1;
+} Calibration;
+#pragma PERSISTENT(Cal_Data)
+Calibration Cal_Data = {0, LB(0), 2560, LB(50.0)};    // 50 lb at 2560, what the old thresholds assumed
+long calGain;                             // Q8 lb per count, Q12
+char Force_Text[] = "\n\r Force nnn.nn lb \n\r";
+unsigned int ADC_Values[ADC_WINDOW];
 char Status_Packet[] = {0, 0, 0, 0, 0, 0, 0};
 char message3[] = "\n\r Drill pressed into unsafe conditions at ";
 char message4[] = "\n\r Alert! Alert! Pressure too high, drill is disabled. \n\r";
+char message5[] = "\n\r Move queue full, press ignored. \n\r";
+char message6[] = "\n\r Soft limit reached, moves cancelled. \n\r";
+char message7[] = "\n\r Pressure trip! Coils off, moves cancelled. \n\r";
+char message8[] = "\n\r Calibration point rejected, the line has to rise. \n\r";
+char Move_Text[] = "\n\r Move dir d, nnnnn steps left, n queued, at snnnnn. \n\r";
+
+// UART Variables
+// Each queued message is a pointer and a length, ISR_EUSCI_A1 sends them back
+// to back in order. The text has to stay put until it is sent, so messages
+// built at run time use their own buffer and check uartQueued() first.
+#define MSG_SIZE 16                       // queue size, power of two
+typedef struct {
+    const char *data;
+    unsigned int length;
+} Message;
+Message Msg_Queue[MSG_SIZE];
+volatile unsigned int msgHead = 0;        // next free slot, written by main
+volatile unsigned int msgTail = 0;        // message being sent, written by ISR
+volatile unsigned int msgSent = 0;        // chars of the current message already sent
+volatile unsigned int msgDropped = 0;     // messages dropped because the queue was full
+char Time_Text[] = "hh:mm:ss on mm/dd/yy\n\r";
+
+// Frame Variables
+// Binary data goes out in frames so line monitoring software can pick it
+// out of the terminal text: FRAME_SYNC, type, payload length (2 bytes),
+// payload, CRC. The CRC is CRC16-CCITT from the CRC module (CRCINIRES
+// seeded 0xFFFF, bytes fed through CRCDIRB_L) over type, length and
+// payload. The payload is queued where it is, each sender keeps its own
+// Frame for the header and CRC while it's sent.
+// Every payload is bytes packed by packWord()/packLong(), u16 and s32
+// little endian whatever the compiler makes of an int, so the layout
+// below is the same on the MSP430 and the host build (host/wire.h
+// decodes it):
+//   status   0 force u16 Q8 lb      2 counts u16       4 zone u8
+//            5 dir u8 (0 fwd, 1 rev, 3 stopped)        6 position s32
+//           10 stepsLeft u16       12 time[7] BCD      19 queued u8
+//   log      LOG_BYTES per record, oldest first
+//            0 time[7] BCD          7 zone u8          8 peak u16
+//           10 duration u16        12 seq u16          14 reserved u16
+//   capture  0 count u16            2 pre u16          4 period u16 (us)
+//            6 level u16            8 count samples u16, oldest first
+#define FRAME_SYNC 0xA5
+#define FRAME_STATUS 1                    // Status_Data
+#define FRAME_LOG 2                       // Log_Ring records, oldest first
+#define FRAME_CAPTURE 3                   // Cap_Head then raw samples, oldest first
+#define STATUS_BYTES 20
+typedef struct {
+    unsigned char head[4];                // FRAME_SYNC, type, length low, length high
+    unsigned char crc[2];                 // low byte first
+} Frame;
+unsigned char Status_Data[STATUS_BYTES];
+Frame Status_Frame;
+Frame Log_Frame;
+Frame Cap_Frame;
+volatile unsigned int telemetryTick = 0;  // ms since the last status frame
+
+// Step Engine Variables
+// coil pattern on P3.0-3 for each half step, even entries drive one coil
+// (wave drive) and odd entries drive two coils (full step)
+#define COILS (BIT0|BIT1|BIT2|BIT3)
+const unsigned char Phase_Table[8] = {BIT0, BIT0|BIT1, BIT1, BIT1|BIT2,
+                                      BIT2, BIT2|BIT3, BIT3, BIT3|BIT0};
+volatile unsigned int phase = 0;         // current entry of Phase_Table
+volatile int stepDelta = 2;              // table stride, negative for CCW
+volatile int stepsLeft = 0;              // steps until the move is done
+
+// Motion Profile Variables
+// Ramp_Table[n] is the TB3 count before step n+1 of a move accelerating from
+// rest, the same table is read backwards to slow down at the end of a move
+#define STEPS_PER_REV 513                // full steps per rotation
+#define MIN_PERIOD 600                   // fastest step, keeps ISR_TB3_CCR0 well under its period
+#define RAMP_SIZE 256
+unsigned int Ramp_Table[RAMP_SIZE];
+volatile unsigned int rampLen = 0;       // table entries used by the current move
+volatile unsigned int cruisePeriod = 0;  // step period once up to speed
+volatile unsigned int stepIndex = 0;     // steps done in the current move
+
+// Scheduler Variables
+// TB3 runs free at TIMER_HZ and each compare channel is its own deadline:
+// CCR0 step pulses, CCR2 1 ms tick (switches, status frames), CCR3 I2C
+// timeout (one shot), CCR4 I2C single byte STOP (one shot), CCR1 and
+// CCR5-6 free. The ADC sample clock stays on TB1 in up mode, TB1.1
+// starts conversions with no ISR. A periodic channel
+// adds its period to its last deadline, not to the time now, so a late
+// interrupt never pushes the later ones back and nothing drifts.
+#define TICK_PERIOD (TIMER_HZ / 1000)
+
+// Move Queue Variables
+// queueMove() works out the whole profile up front and queues it, ISR_TB3_CCR0
+// loads the next move on the same tick the last one ends, so stacked moves run
+// back to back. main() is the only writer of moveHead and the ISR the only
+// writer of moveTail, except stopMove() which flushes with interrupts off.
+#define MOVE_SIZE 4                      // queue size, power of two
+typedef struct {
+    int dir;                             // 0 = CW (forward), 1 = CCW (reverse)
+    int delta;                           // Phase_Table stride
+    int parity;                          // phase&1 the move needs, -1 for half step
+    unsigned int steps;
+    unsigned int rampLen;
+    unsigned int cruise;
+} Move;
+Move Move_Queue[MOVE_SIZE];
+volatile unsigned int moveHead = 0;      // next free slot, written by main
+volatile unsigned int moveTail = 0;      // next move to load, written by ISR
+
+// Position Variables
+// absolute position in half steps, the step engine adds stepDelta on every
+// step so wave, full and half stepping all count in the same units
+volatile long position = 0;
+char cmdEntry = 0;                       // 'g', 'l', 'h' or 's' while its number is being typed
+long cmdValue = 0;
+int cmdSign = 1;
 
 // Subroutines
 int init(void);
-int rotateCW(void);
-int rotateCCW(void);
-int transmit(void);
+int clockInit(void);
+unsigned int uartBrs(unsigned int frac);
+int startMove(int direction, int steps, unsigned int rpm);
+int queueMove(int direction, unsigned int steps, unsigned int rpm);
+int rampInit(void);
+unsigned int isqrt(unsigned long value);
+int stopMove(void);
+int moveFlush(void);
+unsigned int moveQueued(void);
+int moveReport(void);
+long movePlanned(void);
+int gotoMove(long target);
+int calInit(void);
+int calSet(int point, unsigned int lb);
+unsigned int countsToLb(unsigned int counts);
+unsigned int lbToCounts(unsigned int lb);
+int forceReport(void);
+int setStepMode(int mode);
+int rtcRead(void);
+int i2cTransfer(unsigned int addr, const char *tx, unsigned int txLen,
+                char *rx, unsigned int rxLen, unsigned int event);
+int i2cReadStart(void);
+int i2cFail(void);
 int uartWarning(void);
 int adcStatus(void);
+int zoneEnter(unsigned int from);
+int logStart(void);
+int logEnd(void);
+int logDump(void);
+int capArm(void);
+int capSend(void);
+int tickTask(void);
+int frameSend(Frame *frame, unsigned int type, const Message *parts, unsigned int count);
+int frameBusy(const Frame *frame);
+unsigned char *packWord(unsigned char *at, unsigned int value);
+unsigned char *packLong(unsigned char *at, long value);
+int statusSend(void);
 int switch1Pressed(void);
 int switch2Pressed(void);
-int adcAverage(void);
+int adcFilter(unsigned int block);
+unsigned int averageFilter(unsigned int value);
+unsigned int medianFilter(unsigned int value);
+unsigned int emaFilter(unsigned int value);
+unsigned int iir1Filter(unsigned int value);
+unsigned int iir2Filter(unsigned int value);
+int adcBlock(unsigned int block);
+int postEvent(unsigned int type, unsigned int data);
+int uartSend(const char *data, unsigned int length);
+int uartQueued(const char *data);
+int uartRoom(void);
+int bcdText(char *text, char value);
+int uartCommand(char command);
+int profRecord(unsigned int id, unsigned int ticks);
+int profDump(void);
+int profReset(void);
+int numText(char *text, unsigned long value, unsigned int width);
+
+// I2C Variables
+// i2cTransfer() starts a transfer: tx bytes are written, then, if there are
+// rx bytes, a repeated start turns the bus around and they're read back.
+// EUSCI_B1_I2C_ISR walks the states and sends the STOP itself, so either
+// part can be any length.
+#define I2C_IDLE 0
+#define I2C_WRITE 1                      // writing the tx bytes
+#define I2C_READ 2                       // reading the rx bytes
+#define I2C_FAIL 3                       // NACK or clock low timeout, waiting for STOP
+#define I2C_TIMEOUT (20 * (TIMER_HZ/1000))  // 20 ms before a transfer is abandoned
+#define I2C_BYTE_TIME ((9*TIMER_HZ + I2C_HZ-1) / I2C_HZ)    // TB3 counts per byte on the bus
+#define I2C_STOP_POLL ((2*TIMER_HZ + I2C_HZ-1) / I2C_HZ)    // two SCL clocks
+#define I2C_NO_EVENT 0xFFFF              // nothing to post when the transfer is done
+#define RTC_ADDR 0x68                    // RTC slave address
+#define RTC_TIME_REG 0x03                // first time register on the RTC
+#define RTC_RETRIES 3                    // failed reads tried again for the warning
+volatile int i2cState = I2C_IDLE;
+volatile unsigned int i2cErrors = 0;     // NACKs and timeouts
+const char *i2cTx;                       // bytes to write
+char *i2cRx;                             // where read bytes go
+unsigned int i2cTxLen = 0;
+unsigned int i2cRxLen = 0;
+unsigned int i2cEvent = I2C_NO_EVENT;    // posted at the STOP if every byte moved
+
+// Profiler Variables
+// TB2 runs free on SMCLK undivided (1 tick = 1 MCLK cycle), PROF_ENTER/PROF_EXIT
+// read it at the start and end of each ISR and handler. It wraps every 65536
+// cycles, 2.7 ms at 24 MHz, nothing timed takes that long. Histogram bucket b
+// counts times under 16<<b cycles, the last bucket everything longer.
+#define PROF_STEP 0                      // ISR_TB3_CCR0
+#define PROF_TICK 1                      // ISR_TB3_CCRn
+#define PROF_ADC 2                       // ADC_ISR
+#define PROF_UART 3                      // ISR_EUSCI_A1
+#define PROF_I2C 4                       // EUSCI_B1_I2C_ISR
+#define PROF_FILTER 5                    // adcFilter
+#define PROF_STATUS 6                    // adcStatus
+#define PROF_RTC 7                       // rtcRead
+#define PROF_WARNING 8                   // uartWarning
+#define PROF_MOVE 9                      // queueMove
+#define PROF_TRIP 10                     // ECOMP0_ISR
+#define PROF_COUNT 11
+#define PROF_BUCKETS 8
+typedef struct {
+    unsigned int min;
+    unsigned int max;
+    unsigned long count;
+    unsigned long sum;
+    unsigned int hist[PROF_BUCKETS];
+} Profile;
+Profile Prof_Data[PROF_COUNT];
+const char Prof_Names[PROF_COUNT][7] = {"STEP  ", "TICK  ", "ADC   ", "UART  ",
+                                        "I2C   ", "FILTER", "STATUS",
+                                        "RTC   ", "WARN  ", "MOVE  ", "TRIP  "};
+const char Prof_Header[] = "\n\rcycles  min   max  mean     count   <16   <32   <64  <128  <256  <512   <1k   1k+\n\r";
+#define PROF_LINE 84                     // 6 name + 3*6 + 10 count + 8*6 hist + 2 end
+char Prof_Text[PROF_COUNT*PROF_LINE];
+#if PROFILE
+#define PROF_ENTER() unsigned int profStart = HAL_PROF_TIME()
+#define PROF_EXIT(id) profRecord(id, (HAL_PROF_TIME() - profStart) & 0xFFFF)   // TB2 wraps at 16 bits, int may not
+#else
+#define PROF_ENTER()
+#define PROF_EXIT(id)
+#endif
 
 // Loop Variables
-int i, count;
-unsigned int endof, position;
-unsigned int Data_Cnt = 0;
+volatile unsigned int Data_Cnt = 0;
 unsigned long int total=0;
-int index=0;
-int width=0;
+unsigned int index=0;
+unsigned int width=0;
+
+// Filter Variables
+#define MEDIAN_SIZE 5                    // odd, samples in the median window
+unsigned int Median_Values[MEDIAN_SIZE];
+unsigned int medianIndex = 0;
+unsigned int medianWidth = 0;
+#define EMA_SHIFT 3                      // y += (x-y)/8, about as quiet as a 16 sample average
+unsigned long emaState = 0;              // output << EMA_SHIFT
+int emaPrimed = 0;
+#define IIR1_ALPHA 6554                  // Q15, 0.2, cutoff ~36 Hz at 1 kHz sampling
+long iir1State = 0;                      // output in Q4
+int iir1Primed = 0;
+// Butterworth low pass, cutoff 0.05 of the sample rate (50 Hz at 1 kHz), Q14
+// b = {329, 658, 329}, a = {16384, -25576, 10508}, sum(b) = sum(a) for unity DC gain
+#define IIR2_B0 329
+#define IIR2_B1 658
+#define IIR2_B2 329
+#define IIR2_A1 -25576
+#define IIR2_A2 10508
+unsigned int Iir2_X[2];                  // last two inputs
+long Iir2_Y[2];                          // last two outputs in Q2
+int iir2Primed = 0;
 
 //Flags
-volatile int printWarning = 0;
-volatile int saveTime = 0;
-volatile int trigger = 1;
-volatile int trigger2 = 1;
-volatile int timeSet = 0;
-volatile int timeReady = 0;
-volatile int adcReady = 0;
-volatile int switch1 = 0;
-volatile int switch2 = 0;
+volatile int saveTime = 0;              // the RTC still needs to be read
+int rtcWarn = 0;                        // print the warning once the read is back
+unsigned int rtcTries = 0;              // warning reads tried again so far
 volatile int dir=3;
 
+// Zone Variables
+// adcStatus() walks zone up or down through Zone_Enter/Zone_Exit (counts,
+// from calInit) and only touches the outputs when the zone changes
+typedef struct {
+    unsigned char red;
+    unsigned char green;
+    unsigned char alarm;
+    unsigned char sw1;                    // forward moves allowed
+} Zone;
+const Zone Zone_Table[ZONE_COUNT] = {
+    {0, 1, 0, 1},                         // ZONE_SAFE
+    {0, 0, 0, 1},                         // ZONE_WARNING
+    {1, 0, 0, 1},                         // ZONE_UNSAFE
+    {1, 0, 1, 0},                         // ZONE_CUTOFF
+};
+unsigned int Zone_Enter[ZONE_COUNT];
+unsigned int Zone_Exit[ZONE_COUNT];
+unsigned int zone = ZONE_SAFE;
+unsigned long Zone_Dwell[ZONE_COUNT];     // samples spent in each zone
+unsigned long zoneTime = 0;               // samples since the last zone change
+
+// Log Variables
+// every stretch at unsafe or above becomes one LOG_BYTES record in a FRAM
+// ring, packed from logPending when the pressure drops back out. logSeq counts records
+// ever written, so the next slot is logSeq & (LOG_SIZE-1) and it only
+// moves on once the record is in.
+#define LOG_SIZE 64                       // records, power of two
+#define LOG_BYTES 16                      // packed record, see Frame Variables
+typedef struct {
+    unsigned char time[7];                // RTC seconds to year in BCD, as in Status_Packet
+    unsigned char zone;                   // highest zone reached
+    unsigned int peak;                    // highest filtered reading, counts
+    unsigned int duration;                // samples at unsafe or above, stops at 65535
+    unsigned int seq;                     // low bits of logSeq
+    unsigned int reserved;                // pads the record to LOG_BYTES
+} LogRecord;
+#pragma PERSISTENT(Log_Ring)
+unsigned char Log_Ring[LOG_SIZE][LOG_BYTES] = {{0}};
+#pragma PERSISTENT(logSeq)
+unsigned long logSeq = 0;
+LogRecord logPending;                     // the record being built
+int logActive = 0;                        // 1 while the pressure is unsafe or above
+
+// Capture Variables
+// ADC_ISR writes raw samples round Cap_Buffer in FRAM while armed, low byte
+// first, after the trigger it keeps going until CAP_SIZE-CAP_PRE more are
+// in, then posts EV_CAPTURE. capSend() sends Cap_Head and the buffer oldest
+// first, if the UART queue has no room it stays CAP_DONE and the tick posts
+// it again.
+#define CAP_SIZE 2048                     // samples, power of two
+#define CAP_IDLE 0
+#define CAP_ARMED 1                       // filling, waiting for the trigger
+#define CAP_POST 2                        // triggered, filling the rest
+#define CAP_DONE 3                        // full, waiting on capSend()
+#define CAP_RETRY 10                      // ms between tries to queue the frame
+#define CAP_HEAD_BYTES 8                  // count, pre, period, level, see Frame Variables
+#pragma PERSISTENT(Cap_Buffer)
+unsigned char Cap_Buffer[CAP_SIZE][2] = {{0}};
+unsigned char Cap_Head[CAP_HEAD_BYTES];
+volatile unsigned int capState = CAP_IDLE;
+volatile unsigned int capWrite = 0;       // next slot, the oldest sample once full
+volatile unsigned int capFill = 0;        // samples in the buffer, up to CAP_SIZE
+volatile unsigned int capLeft = 0;        // samples still to take after the trigger
+volatile unsigned int capSkip = 0;        // samples since the last one stored
+unsigned int capRetry = 0;                // ms since the last try, tick only
+unsigned int capLevel;                    // CAP_LEVEL in counts
+unsigned int capLast;                     // last stored sample, for the rising edge
+
+// Switch Variables
+// tickTask() samples both switches on the 1 ms tick. Each
+// switch has an integrator that counts up while the pin reads pressed and
+// down while it reads released, the state only flips at the ends, so bounces
+// shorter than SW_DEBOUNCE ms never make it through.
+#define SW_DEBOUNCE 5                   // ms a switch has to settle
+#define SW_LONG 1000                    // ms held before a long press
+#define SW_PRESS 0x00                   // EV_SWITCH data: kind | switch number
+#define SW_RELEASE 0x10
+#define SW_LONGPRESS 0x20
+typedef struct {
+    unsigned int level;                 // integrator, 0 to SW_DEBOUNCE
+    unsigned int pressed;               // debounced state
+    unsigned int held;                  // ms since the press
+} Switch;
+Switch Switches[2];
+volatile int sw1Enabled = 1;            // adcStatus drops SW1 presses past cutoff
+volatile int tripped = 0;               // eCOMP0 over TRIP_LEVEL, no forward moves
+
+// Events
+// ISRs push typed events with a payload, main() pops them in order and sleeps
+// in LPM0 while the queue is empty. ISRs do not nest, so they act as a single
+// producer, and main() is the only consumer: evHead has one writer (ISRs) and
+// evTail has one writer (main), so the queue needs no lock.
+#define EV_ADC 0                        // data: ADC_Block index with new samples
+#define EV_RTC 1                        // read the time from the RTC
+#define EV_WARNING 2                    // RTC time is in, print the warning
+#define EV_SWITCH 3                     // data: SW_PRESS/SW_RELEASE/SW_LONGPRESS | switch number, 1 or 2
+#define EV_COMMAND 4                    // data: char received over UART
+#define EV_LIMIT 5                      // data: dir of the move that hit a soft limit
+#define EV_CAPTURE 6                    // raw capture is full
+#define EV_STATUS 7                     // time for a status frame
+#define EV_TRIP 8                       // eCOMP0 cut the coils
+#define EV_SIZE 16                      // queue size, power of two
+typedef struct {
+    unsigned int type;
+    unsigned int data;
+} Event;
+Event Event_Queue[EV_SIZE];
+volatile unsigned int evHead = 0;       // next free slot, written by ISRs
+volatile unsigned int evTail = 0;       // next event to handle, written by main
+volatile unsigned int evDropped = 0;    // events lost to a full queue
+int getEvent(Event *ev);                // takes an Event, so not up with the others
+
 
 //--------------- MAIN -------------------------------------------
 int main(void) {
@@ -90,52 +637,73 @@ int main(void) {
     init();
 
     // Set RTC with Current Time:
-    UCB1CTLW0 |= UCTR;               // put into Tx mode
-    UCB1CTLW0 |= UCTXSTT;            // start condition
-
-    while((UCB1IFG & UCSTPIFG) ==0); // wait for STOP condition
-        UCB1IFG &= ~UCSTPIFG;        // clear stop flag
-
-    timeSet = 1;
-    Data_Cnt=0;                      // signal that we initialized and reset counter
+    // Start_Packet begins with the register it's written to
+    i2cTransfer(RTC_ADDR, Start_Packet, sizeof(Start_Packet), 0, 0, I2C_NO_EVENT);
+
+    // only blocks once, at start up, the STOP wakes it
+    __disable_interrupt();
+    while(i2cState != I2C_IDLE){
+        __bis_SR_register(LPM0_bits | GIE);
+        __disable_interrupt();
+    }
+    __enable_interrupt();
 
     // Infinite loop
     while(1){
-
-        // if done collecting the timestamp of warning, will send the timestamp.
-        if(adcReady == 1){
-            adcAverage();
-            adcStatus();
+        Event ev;
+
+        // sleep until an ISR posts an event
+        __disable_interrupt();
+        if(evTail == evHead){
+            __bis_SR_register(LPM0_bits | GIE);     // wakes with interrupts on
+            __no_operation();
+            continue;
         }
+        __enable_interrupt();
 
-        // if warning triggered, will read the time
-        if(saveTime==1){
-            transmit();
-        }
-        // if done collecting the timestamp of warning, will send the timestamp.
-        if(printWarning == 1){
-            uartWarning();
+        if(getEvent(&ev) != 0){
+            continue;                   // can't happen, main is the only consumer
         }
 
-        // if the switch 1 pressed signal motor needs to be moved
-        if(switch1==1){
-            switch1Pressed();
-        }
-        // if the switch 2 pressed signal motor needs to be moved
-        if(switch2==1){
-            switch2Pressed();
-        }
-        // if the clock is high, checks if motor needs to be moved
-        if(timeReady == 1){
-            timeReady = 0;
-            if(dir==0){
-                rotateCW();
-            }else if(dir==1){
-                rotateCCW();
+        switch(ev.type){
+        case EV_ADC:
+            adcBlock(ev.data);
+            break;
+        case EV_RTC:
+            rtcRead();
+            break;
+        case EV_WARNING:
+            if(rtcWarn){                // not for the status frame reads
+                rtcWarn = 0;
+                uartWarning();
+            }
+            break;
+        case EV_SWITCH:
+            if(ev.data == (SW_PRESS | 1)){
+                switch1Pressed();
+            }else if(ev.data == (SW_PRESS | 2)){
+                switch2Pressed();
             }
+            break;
+        case EV_COMMAND:
+            uartCommand(ev.data);
+            break;
+        case EV_LIMIT:
+            uartSend(message6, sizeof(message6)-1);
+            break;
+        case EV_CAPTURE:
+            capSend();
+            break;
+        case EV_STATUS:
+            statusSend();
+            break;
+        case EV_TRIP:
+            uartSend(message7, sizeof(message7)-1);
+            break;
+        default:
+            break;
         }
     }
-
     return 0;
 }
 //--------------- End MAIN -------------------------------------------
@@ -154,24 +722,24 @@ int init(void){
     UCB1CTLW0 |= UCSWRST;       // i2c sw reset
 
     // 2. CONFIGURE CLOCKS
+    clockInit();
 
     // UART
     UCA1CTLW0 |= UCSSEL__SMCLK;
 
-    UCA1BRW = 17;
-    UCA1MCTLW |= 0x4A00;            // baud 57600
+    UCA1BRW = UART_BR;
+    UCA1MCTLW = UCOS16 | (UART_BRF << 4) | (uartBrs(UART_FRAC) << 8);   // BAUD
 
     // I2C
-    UCB1CTLW0 |= UCSSEL__SMCLK;      // choose brclk=smclk=1MHz
-    UCB1BRW = 10;               // divide brclk by 10 so scl=100kHz
+    UCB1CTLW0 |= UCSSEL__SMCLK;      // choose brclk=smclk
+    UCB1BRW = MCLK_HZ / I2C_HZ;      // divide brclk so scl=I2C_HZ
 
-    // eUSCI_B1 is i2c master that goes to slave with addr 0x68
+    // eUSCI_B1 is i2c master, i2cTransfer() sets the slave address
     UCB1CTLW0 |= UCMODE_3;      // put into I2C mode
     UCB1CTLW0 |= UCMST;         // master mode
-    UCB1I2CSA = 0x0068;          // slave address = 0x68
+    UCB1I2CSA = RTC_ADDR;
 
-    UCB1CTLW1 |= UCASTP_2;                    // auto stop
-    UCB1TBCNT = sizeof(Start_Packet);         // sends number of bytes in packet
+    UCB1CTLW1 |= UCCLTO_1;                    // clock low timeout ~34 ms
 
     // 3. CONFIG PORTS
     // SWITCHES
@@ -179,12 +747,10 @@ int init(void){
     P4DIR &= ~BIT1;
     P4REN |= BIT1;
     P4OUT |= BIT1;
-    P4IES |= BIT1;
     // SW2
     P2DIR &= ~BIT3;
     P2REN |= BIT3;
     P2OUT |= BIT3;
-    P2IES |= BIT3;
 
     // LEDS
     // Red LED 1: P1.0
@@ -224,14 +790,22 @@ int init(void){
     P3OUT &= ~BIT4;
 
     // UART
-    P4SEL1 &= ~BIT3;
+    P4SEL1 &= ~BIT3;            // p4.3 = txd
     P4SEL0 |= BIT3;
+    P4SEL1 &= ~BIT2;            // p4.2 = rxd
+    P4SEL0 |= BIT2;
 
-    // CLOCK SETUP
-    TB0CTL |= TBCLR;                 // TBCLR=1 clears timers and dividers
-    TB0CTL |= TBSSEL__SMCLK;         // TBSSEL =10 picks SMCLK as timing source
+    // SCHEDULER TIMER
+    TB3CTL |= TBCLR;                 // TBCLR=1 clears timers and dividers
+    TB3CTL |= TBSSEL__SMCLK;         // TBSSEL =10 picks SMCLK as timing source
+    TB3CTL |= ID__8;                 // /8 then /TBIDEX, counts at TIMER_HZ
+    TB3EX0 = CLK_TBIDEX;
+    TB3CTL |= MC__CONTINUOUS;        // free running, the channels set their own deadlines
 
-    TB0CTL |= MC__UP;                // compare setting
+    // PROFILER TIMER
+    TB2CTL |= TBCLR;                 // TBCLR=1 clears timers and dividers
+    TB2CTL |= TBSSEL__SMCLK;         // TBSSEL =10 picks SMCLK as timing source, undivided
+    TB2CTL |= MC__CONTINUOUS;        // free running, counts MCLK cycles
 
     // CONFIGURE ADC:
     P1SEL1 |= BIT4;                     // configure p1.4 pin for a4
@@ -242,13 +816,38 @@ int init(void){
     ADCCTL0 |= ADCON;                   // turn adc on
 
     ADCCTL1 |= ADCSSEL_2;               // adc clock source = smclk
+    ADCCTL1 |= CLK_ADCDIV;              // divided down to 5 MHz or less
     ADCCTL1 |= ADCSHP;                  // sample signal source= sampling timer
+    ADCCTL1 |= ADCSHS_2;                // conversion trigger = TB1.1 output
+    ADCCTL1 |= ADCCONSEQ_2;             // repeat single channel, one conversion per trigger,
+                                        // CONSEQ_0 would stop after the first until ENC is toggled
 
     ADCCTL2 &= ~ADCRES;                 // clear adcres from def of adcres=01
     ADCCTL2 |= ADCRES_2;                // resolution = 12bit (ADCRES=10)
-    ADCCTL2 |=
 
     ADCMCTL0 |= ADCINCH_4;              // adc input channel = A4 (P1.4)
+    ADCCTL0 |= ADCENC;                  // enable, TB1.1 starts every conversion
+
+    // SAMPLE CLOCK
+    TB1CTL |= TBCLR;                    // TBCLR=1 clears timers and dividers
+    TB1CTL |= TBSSEL__SMCLK;            // TBSSEL =10 picks SMCLK as timing source
+    TB1CTL |= ID__8;                    // /8 then /TBIDEX, counts at TIMER_HZ
+    TB1EX0 = CLK_TBIDEX;
+    TB1CCR0 = SAMPLE_PERIOD-1;
+    TB1CCR1 = SAMPLE_PERIOD/2;
+    TB1CCTL1 = OUTMOD_7;                // reset/set, rising edge at CCR0 triggers the adc
+    TB1CTL |= MC__UP;                   // compare setting
+
+    // CONFIGURE COMPARATOR:
+    P1SEL1 |= BIT1;                     // configure p1.1 pin for c1
+    P1SEL0 |= BIT1;
+
+    CP0CTL0 = CPPSEL_1 | CPNSEL_6;      // + input = C1 (P1.1), - input = DAC
+    CP0CTL0 |= CPPEN | CPNEN;           // connect both inputs
+    CP0DACCTL = CPDACEN;                // DAC on, VDD reference like the ADC, calInit() sets it
+    CP0CTL1 = CPHSEL_3;                 // 30 mV hysteresis
+    CP0CTL1 |= CPFLT | CPFLTDLY_1;      // ~900 ns filter against spikes
+    CP0CTL1 |= CPEN;                    // comparator on, high speed mode, rising edge
 
     // I2C PINS SETUP
     P4SEL1 &= ~BIT7;            // we want p4.7 = scl
@@ -265,27 +864,33 @@ int init(void){
     // ADC:
     ADCIE |= ADCIE0;                    // enable adc irq
 
+    // COMPARATOR:
+    CP0INT |= CPIE | CPIIE;             // enable trip and trip clear irqs
+
+    // UART:
+    UCA1IE |= UCRXIE;           // enable UART Rx IRQ, commands from the terminal
+
     // I2C:
     UCB1IE |= UCTXIE0;          // enable I2C Rx0 IRQ
     UCB1IE |= UCRXIE0;          // enable I2C Tx0 IRQ
+    UCB1IE |= UCSTPIE;          // enable STOP IRQ, ends a transfer
+    UCB1IE |= UCNACKIE;         // enable NACK IRQ
+    UCB1IE |= UCCLTOIE;         // enable clock low timeout IRQ
+
+    // PRESSURE CALIBRATION
+    calInit();
+    zoneEnter(ZONE_SAFE);       // green until the first reading
+
+    // TB3 deadlines:
+    rampInit();
+    TB3CCR0 = Ramp_Table[0];     // step engine, polls the move queue while stopped
+    TB3CCTL0 &= ~CCIFG;          // CCIFG=0 clears interrupt flag
+    TB3CCTL0 |= CCIE;            // CCIE=1 enables compare interrupt
+
+    TB3CCR2 = TICK_PERIOD;       // 1 ms tick
+    TB3CCTL2 &= ~CCIFG;
+    TB3CCTL2 |= CCIE;
 
-    // TB0:
-    TB0CCR0 = fspeed;
-    TB0CCTL0 |= CCIFG;           // CCIFG=0 clears interrupt flag
-    TB0CCTL0 |= CCIE;            // CCIE=1 enables compare interrupt
-    // TB1: (for ADC)
-    TB0CCR1 = 300;
-    TB0CCTL1 |= CCIFG;           // CCIFG=0 clears interrupt flag
-    TB0CCTL1 |= CCIE;            // CCIE=1 enables compare interrupt
-
-    // SW1:
-    P4IFG &= ~BIT1;             // clear interrupt flag
-    P4IES |= BIT1;             // sets IRQ to high to low
-    P4IE |= BIT1;               // asserts local enable
-    // SW2:
-    P2IFG &= ~BIT3;             // clear interrupt flag
-    P2IES |= BIT3;             // sets IRQ to high to low
-    P2IE |= BIT3;               // asserts local enable
 
     // 6. GLOBAL INTERRUPT AND HIGH Z
     __enable_interrupt();
@@ -295,463 +900,1823 @@ int init(void){
 }
 //--------------- End Init ---------------------------------------
 
-//--------------- Transmit ---------------------------------------
-// Start the reading of the time on the RTC by using I2C
-//----------------------------------------------------------------
+//--------------- clockInit ------------------------------------------
+// Sets the FRAM wait states then brings the DCO up to MCLK_MHZ on the
+// FLL. Waits for the FLL to lock, only at start up.
+//--------------------------------------------------------------------
 
-int transmit(void){
-    // reset flag
-    saveTime==0;
-    // Transmit Register addr with write message
-    timeSet=1;
-    UCB1TBCNT = 0x01;         // sends number of bytes in packet
-    UCB1CTLW0 |= UCTR;               // put into Tx mode
-    UCB1CTLW0 |= UCTXSTT;            // start condition
+int clockInit(void){
+    FRCTL0 = FRCTLPW | CLK_NWAITS;      // wait states before the clock goes up
+
+    __bis_SR_register(SCG0);            // FLL off while it's set up
+    CSCTL3 = SELREF__REFOCLK;           // FLL reference = REFO
+    CSCTL0 = 0;                         // clear DCO and MOD, the FLL finds them
+    CSCTL1 = CLK_DCORSEL;
+    CSCTL2 = FLLD_0 + CLK_FLLN;         // DCOCLKDIV = MCLK_HZ
+    __delay_cycles(3);
+    __bic_SR_register(SCG0);            // FLL on
+    while(CSCTL7 & (FLLUNLOCK0 | FLLUNLOCK1));  // wait for lock
 
-    while((UCB1IFG & UCSTPIFG) ==0); // wait for STOP condition
-        UCB1IFG &= ~UCSTPIFG;        // clear stop flag
+    CSCTL4 = SELMS__DCOCLKDIV | SELA__REFOCLK;  // MCLK = SMCLK = DCOCLKDIV, ACLK = REFO
+    return 0;
+}
+
+//--------------- End clockInit --------------------------------------
+
+//--------------- uartBrs --------------------------------------------
+// UCBRS for the fraction of MCLK/BAUD, in 1/10000ths, from the table
+// in the eUSCI UART chapter of the user's guide
+//--------------------------------------------------------------------
+
+unsigned int uartBrs(unsigned int frac){
+    static const unsigned int Frac_Table[36] = {
+        0, 529, 715, 835, 1001, 1252, 1430, 1670, 2147, 2224, 2503, 3000,
+        3335, 3575, 3753, 4003, 4286, 4378, 5002, 5715, 6003, 6254, 6432, 6667,
+        7001, 7147, 7503, 7861, 8004, 8333, 8464, 8572, 8751, 9004, 9170, 9288};
+    static const unsigned char Brs_Table[36] = {
+        0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x11, 0x21, 0x22, 0x44, 0x25,
+        0x49, 0x4A, 0x52, 0x92, 0x53, 0x55, 0xAA, 0x6B, 0xAD, 0xB5, 0xB6, 0xD6,
+        0xB7, 0xBB, 0xDD, 0xED, 0xEE, 0xBF, 0xDF, 0xEF, 0xF7, 0xFB, 0xFD, 0xFE};
+    unsigned int n = 0;
+
+    while(n < 35 && frac >= Frac_Table[n+1]){
+        n++;
+    }
+    return Brs_Table[n];
+}
 
-    UCB1TBCNT = sizeof(Status_Packet);         // sends number of bytes in packet
+//--------------- End uartBrs ----------------------------------------
 
-    // recieve data from Rx
-    UCB1CTLW0 &= ~UCTR;                 // put into Rx mode
-    UCB1CTLW0 |= UCTXSTT;               // generate start conditions
+//--------------- rtcRead ----------------------------------------
+// Starts reading the time from the RTC over I2C and returns right away.
+// One transfer writes the register address, turns the bus around with
+// a repeated start, reads Status_Packet and posts EV_WARNING at the STOP.
+// Returns -1 and leaves saveTime set if the bus is still busy.
+//----------------------------------------------------------------
+
+int rtcRead(void){
+    static const char Time_Reg[] = {RTC_TIME_REG};
+    PROF_ENTER();
+
+    if(i2cState != I2C_IDLE){
+        PROF_EXIT(PROF_RTC);
+        return -1;                  // the ISR posts EV_RTC again when the bus frees up
+    }
+    // reset flag
+    saveTime = 0;
 
-    while((UCB1IFG & UCSTPIFG)==0);     // wait for stop
-        UCB1IFG &= ~UCSTPIFG;               //clear stop flag
+    i2cTransfer(RTC_ADDR, Time_Reg, sizeof(Time_Reg),
+                Status_Packet, sizeof(Status_Packet), EV_WARNING);
 
+    PROF_EXIT(PROF_RTC);
     return 0;
 }
 
-//--------------- End Transmit ---------------------------------------
+//--------------- End rtcRead ---------------------------------------
 
-//--------------- rotateCW/CCW ---------------------------------------
-// Rotates the motor CW or CCW by powering one output at a time.
-//----------------------------------------------------------------
+//--------------- i2cTransfer ----------------------------------------
+// Starts a write, read, or write then repeated start read to addr and
+// returns right away. tx and rx have to stay put until the STOP, when
+// EUSCI_B1_I2C_ISR posts event (unless I2C_NO_EVENT) if every byte moved.
+// Returns -1 if the bus is busy or there's nothing to move.
+//--------------------------------------------------------------------
 
-//--------------- rotateCW ---------------------------------------
-
-int rotateCW(void){
-    if(count<=fspin){
-        if(count%4==1){
-            P3OUT |= BIT0;
-            P3OUT &= ~BIT3;
-        }else if(count%4==2){
-            P3OUT |= BIT1;
-            P3OUT &= ~BIT0;
-        }else if(count%4==3){
-            P3OUT |= BIT2;
-            P3OUT &= ~BIT1;
-        }else{
-            P3OUT |= BIT3;
-            P3OUT &= ~BIT2;
-        }
+int i2cTransfer(unsigned int addr, const char *tx, unsigned int txLen,
+                char *rx, unsigned int rxLen, unsigned int event){
+    if(i2cState != I2C_IDLE || (txLen == 0 && rxLen == 0)){
+        return -1;
+    }
+    i2cTx = tx;
+    i2cTxLen = txLen;
+    i2cRx = rx;
+    i2cRxLen = rxLen;
+    i2cEvent = event;
+    Data_Cnt = 0;
+
+    HAL_I2C_ADDRESS(addr);
+    HAL_I2C_TIMEOUT(I2C_TIMEOUT);
+    if(txLen > 0){
+        i2cState = I2C_WRITE;
+        HAL_I2C_WRITE();            // Tx mode and start condition
     }else{
-        P3OUT |= BIT0;
-        P3OUT &= ~BIT1;
-        P3OUT &= ~BIT2;
-        P3OUT &= ~BIT3;
-        dir = 3;
+        i2cState = I2C_READ;
+        i2cReadStart();
     }
-    count++;
     return 0;
 }
 
-//--------------- End rotateCW -------------------------------------
+//--------------- End i2cTransfer ------------------------------------
 
-//--------------- rotateCCW ----------------------------------------
+//--------------- i2cReadStart ---------------------------------------
+// (Repeated) start in Rx mode. The STOP has to be asked for while the last
+// byte comes in, so for a single byte it has to go in once the address is
+// out and before that byte is in. The TB3 CCR4 deadline checks for that
+// instead of waiting here, this runs from EUSCI_B1_I2C_ISR.
+//--------------------------------------------------------------------
 
-int rotateCCW(void){
-    if(count<=rspin){
-        if(count%4==1){
-            P3OUT |= BIT3;
-            P3OUT &= ~BIT0;
-        }else if(count%4==2){
-            P3OUT |= BIT2;
-            P3OUT &= ~BIT3;
-        }else if(count%4==3){
-            P3OUT |= BIT1;
-            P3OUT &= ~BIT2;
-        }else{
-            P3OUT |= BIT0;
-            P3OUT &= ~BIT1;
-        }
-    }else{
-        P3OUT |= BIT0;
-        P3OUT &= ~BIT1;
-        P3OUT &= ~BIT2;
-        P3OUT &= ~BIT3;
-        dir = 3;
+int i2cReadStart(void){
+    HAL_I2C_READ();
+    if(i2cRxLen == 1){
+        HAL_I2C_STOP_AT(I2C_BYTE_TIME);     // the address takes about a byte
     }
-    count++;
     return 0;
 }
 
-//--------------- End rotateCCW --------------------------------------
+//--------------- End i2cReadStart -----------------------------------
 
-//--------------- uartWarning ----------------------------------------
-// Outputs message to serial terminal with timestamp of drill press.
+//--------------- i2cFail --------------------------------------------
+// A NACK, clock low timeout or transfer timeout. Counts it, and while the
+// warning still waits on the time has the read tried again once the bus
+// is free, up to RTC_RETRIES times.
 //--------------------------------------------------------------------
 
-int uartWarning(void){
-    // reset flag
-    printWarning = 0;
-    // print first part of message
-    dir = 4;
-    endof = sizeof(message3)-1;
-    position = 0;
-    UCA1IE |= UCTXCPTIE;
-    UCA1IFG &= ~UCTXCPTIFG;
-    UCA1TXBUF = message3[position];
-    for (i = 0; i < 1000; i++){
+int i2cFail(void){
+    i2cErrors++;
+    if(rtcWarn && i2cEvent == EV_WARNING && rtcTries < RTC_RETRIES){
+        rtcTries++;
+        saveTime = 1;               // EV_RTC goes out when the bus is free
     }
-    // print hours
-    UCA1TXBUF = ((Status_Packet[2] & 0xF0)>>4) + '0'; // Prints the 10s digit
-    for (i = 0; i < 500; i++){
+    return 0;
+}
+
+//--------------- End i2cFail ----------------------------------------
+
+//--------------- startMove ------------------------------------------
+// Queues a move of steps full steps, twice as many half steps in
+// STEP_HALF so a move turns the same angle in every mode.
+// direction: 0 = CW (forward), 1 = CCW (reverse)
+// returns -1 if the queue is full, -2 for a forward move past cutoff
+//--------------------------------------------------------------------
+
+int startMove(int direction, int steps, unsigned int rpm){
+    if(stepMode == STEP_HALF){
+        steps = steps << 1;         // twice the steps for the same angle
     }
-    UCA1TXBUF = (Status_Packet[2] & 0x0F) + '0'; // Prints the 1s digit
-    for (i = 0; i < 500; i++){
+    return queueMove(direction, steps, rpm);
+}
+
+//--------------- End startMove --------------------------------------
+
+//--------------- queueMove ------------------------------------------
+// Queues a move for the step engine. ISR_TB3_CCR0 does the stepping,
+// so this only works out the direction and speed profile. steps are
+// the engine's, half steps in STEP_HALF.
+// direction: 0 = CW (forward), 1 = CCW (reverse)
+// returns -1 if the queue is full, -2 for a forward move past cutoff
+//--------------------------------------------------------------------
+
+int queueMove(int direction, unsigned int steps, unsigned int rpm){
+    unsigned long period;
+    unsigned int n;
+    Move *m;
+    PROF_ENTER();
+
+    // no feeding at cutoff or after a trip, whoever asks for it
+    if(direction == 0 && (zone == ZONE_CUTOFF || tripped)){
+        PROF_EXIT(PROF_MOVE);
+        return -2;
     }
-    // print spacer
-    UCA1TXBUF = ':';
-    for (i = 0; i < 500; i++){
+    if(((moveHead+1) & (MOVE_SIZE-1)) == moveTail){
+        PROF_EXIT(PROF_MOVE);
+        return -1;
     }
-    // print minutes
-    UCA1TXBUF = ((Status_Packet[1] & 0xF0)>>4) + '0'; // Prints the 10s digit
-    for (i = 0; i < 500; i++){
+    m = &Move_Queue[moveHead];
+
+    // wave drive uses the even table entries, full step the odd ones
+    if(stepMode == STEP_WAVE){
+        m->parity = 0;
+    }else if(stepMode == STEP_FULL){
+        m->parity = 1;
+    }else{
+        m->parity = -1;
     }
-    UCA1TXBUF = (Status_Packet[1] & 0x0F) + '0'; // Prints the 1s digit
-    for (i = 0; i < 500; i++){
-    };
-    // print spacer
-    UCA1TXBUF = ':';
-    for (i = 0; i < 500; i++){
+
+    // cruise period in timer counts per step
+    period = (TIMER_HZ*60) / ((unsigned long)rpm * STEPS_PER_REV);
+    if(stepMode == STEP_HALF){
+        m->delta = 1;
+        period = period >> 1;       // at half the period for the same rpm
+    }else{
+        m->delta = 2;
     }
-    // print seconds
-    UCA1TXBUF = ((Status_Packet[0] & 0xF0)>>4) + '0'; // Prints the 10s digit
-    for (i = 0; i < 500; i++){
+    if(direction == 1){
+        m->delta = -m->delta;
     }
-    UCA1TXBUF = (Status_Packet[0] & 0x0F) + '0'; // Prints the 1s digit
-    for (i = 0; i < 500; i++){
+    if(period > 0xFFFF){
+        period = 0xFFFF;
     }
 
-    // print spacer
-    UCA1TXBUF = ' ';
-    for (i = 0; i < 500; i++){
-    }
-    UCA1TXBUF = 'o';
-    for (i = 0; i < 500; i++){
+    // ramp until the table reaches the cruise period, if the table runs out
+    // first the move cruises at the fastest speed the ramp got to
+    n = 0;
+    while(n < RAMP_SIZE-1 && Ramp_Table[n] > period){
+        n++;
     }
-    UCA1TXBUF = 'n';
-    for (i = 0; i < 500; i++){
+    if(Ramp_Table[n] > period){
+        period = Ramp_Table[n];
     }
-    UCA1TXBUF = ' ';
-    for (i = 0; i < 500; i++){
+    m->rampLen = n;
+    m->cruise = period;
+    m->steps = steps;
+    m->dir = direction;
+
+    moveHead = (moveHead+1) & (MOVE_SIZE-1);    // the ISR picks it up from here
+
+    PROF_EXIT(PROF_MOVE);
+    return 0;
+}
+
+//--------------- End queueMove --------------------------------------
+
+//--------------- stopMove -------------------------------------------
+// Ends the current move and drops the queued ones, the coils hold the last phase
+//--------------------------------------------------------------------
+
+int stopMove(void){
+    __disable_interrupt();
+    moveTail = moveHead;
+    stepsLeft = 0;
+    dir = 3;
+    __enable_interrupt();
+    return 0;
+}
+
+//--------------- End stopMove ---------------------------------------
+
+//--------------- moveFlush ------------------------------------------
+// Drops the queued moves, the current one runs to the end
+//--------------------------------------------------------------------
+
+int moveFlush(void){
+    __disable_interrupt();
+    moveTail = moveHead;
+    __enable_interrupt();
+    return 0;
+}
+
+//--------------- End moveFlush --------------------------------------
+
+//--------------- moveQueued -----------------------------------------
+// Number of moves waiting behind the current one
+//--------------------------------------------------------------------
+
+unsigned int moveQueued(void){
+    return (moveHead - moveTail) & (MOVE_SIZE-1);
+}
+
+//--------------- End moveQueued -------------------------------------
+
+//--------------- moveReport -----------------------------------------
+// Sends the current move and queue depth over the UART
+//--------------------------------------------------------------------
+
+int moveReport(void){
+    long at;
+
+    // the last report is still going out
+    if(uartQueued(Move_Text)){
+        return -1;
     }
 
-    // print month
-    UCA1TXBUF = ((Status_Packet[5] & 0xF0)>>4) + '0'; // Prints the 10s digit
-    for (i = 0; i < 500; i++){
+    // 32 bits take two reads, ISR_TB3_CCR0 can't step in between
+    __disable_interrupt();
+    at = position;
+    __enable_interrupt();
+
+    Move_Text[12] = dir + '0';      // 3 = stopped
+    numText(&Move_Text[15], stepsLeft, 5);
+    numText(&Move_Text[33], moveQueued(), 1);
+    Move_Text[46] = (at < 0) ? '-' : '+';
+    numText(&Move_Text[47], (at < 0) ? -at : at, 5);
+
+    uartSend(Move_Text, sizeof(Move_Text)-1);
+    return 0;
+}
+
+//--------------- End moveReport -------------------------------------
+
+//--------------- movePlanned ----------------------------------------
+// Position the axis ends up at once the current and queued moves are done
+//--------------------------------------------------------------------
+
+long movePlanned(void){
+    long planned;
+    unsigned int n;
+
+    __disable_interrupt();
+    planned = position + (long)stepsLeft * stepDelta;
+    for(n=moveTail; n!=moveHead; n=(n+1) & (MOVE_SIZE-1)){
+        planned += (long)Move_Queue[n].steps * Move_Queue[n].delta;
     }
-    UCA1TXBUF = (Status_Packet[5] & 0x0F) + '0'; // Prints the 1s digit
-    for (i = 0; i < 500; i++){
+    __enable_interrupt();
+    return planned;
+}
+
+//--------------- End movePlanned ------------------------------------
+
+//--------------- gotoMove -------------------------------------------
+// Queues the move from wherever the queue ends up to target (half steps),
+// feeds at frpm and retracts at rrpm. Targets past the soft limits stop at
+// the limit. Wave and full stepping land on the nearest full step, half
+// stepping goes the half steps as they are.
+//--------------------------------------------------------------------
+
+int gotoMove(long target){
+    long diff;
+    unsigned int steps;
+
+    if(target > posMax){
+        target = posMax;
+    }else if(target < posMin){
+        target = posMin;
     }
-    // print spacer
-    UCA1TXBUF = '/';
-    for (i = 0; i < 500; i++){
+
+    diff = target - movePlanned();
+    steps = (diff < 0) ? -diff : diff;
+    if(stepMode != STEP_HALF){
+        steps = steps >> 1;         // full steps, two half steps each
     }
-    // print day
-    UCA1TXBUF = ((Status_Packet[3] & 0xF0)>>4) + '0'; // Prints the 10s digit
-    for (i = 0; i < 500; i++){
+    if(steps == 0){
+        return 0;                   // already there
     }
-    UCA1TXBUF = (Status_Packet[3] & 0x0F) + '0'; // Prints the 1s digit
-    for (i = 0; i < 500; i++){
+    if(diff > 0){
+        return queueMove(0, steps, frpm);
     }
-    // print spacer
-    UCA1TXBUF = '/';
-    for (i = 0; i < 500; i++){
+    return queueMove(1, steps, rrpm);
+}
+
+//--------------- End gotoMove ---------------------------------------
+
+//--------------- calInit --------------------------------------------
+// Works out the gain from the calibration points and converts the
+// zone levels and the trip level to counts. Falls back to the defaults
+// if FRAM holds two points that can't make a line.
+//--------------------------------------------------------------------
+
+int calInit(void){
+    unsigned int n;
+    unsigned int code;
+
+    if(Cal_Data.count1 <= Cal_Data.count0 || Cal_Data.lb1 <= Cal_Data.lb0){
+        HAL_FRAM_OPEN();
+        Cal_Data.count0 = 0;
+        Cal_Data.lb0 = LB(0);
+        Cal_Data.count1 = 2560;
+        Cal_Data.lb1 = LB(50.0);
+        HAL_FRAM_CLOSE();
     }
-    // print year
-    UCA1TXBUF = ((Status_Packet[6] & 0xF0)>>4) + '0'; // Prints the 10s digit
-    for (i = 0; i < 500; i++){
+
+    calGain = ((long)(Cal_Data.lb1 - Cal_Data.lb0) << 12) / (Cal_Data.count1 - Cal_Data.count0);
+
+    for(n=0; n<ZONE_COUNT; n++){
+        Zone_Enter[n] = lbToCounts(Zone_Enter_Lb[n]);
+        Zone_Exit[n] = lbToCounts(Zone_Exit_Lb[n]);
     }
-    UCA1TXBUF = (Status_Packet[6] & 0x0F) + '0'; // Prints the 1s digit
-    for (i = 0; i < 500; i++){
+
+    // DAC step = 4096/64 counts, rounded up so it never trips early. Both DAC
+    // buffers get the code: CPOUT picks the buffer, so a low one would hold
+    // the comparator high after a trip and the trip would never clear
+    code = (lbToCounts(TRIP_LEVEL) + 63) >> 6;
+    HAL_TRIP_LEVEL((code > 63) ? 63 : code);
+    return 0;
+}
+
+//--------------- End calInit ----------------------------------------
+
+//--------------- calSet ---------------------------------------------
+// Makes the current filtered reading calibration point 0 or 1 at lb (Q8)
+// and keeps it in FRAM. The other point stays, the new line takes effect
+// right away. A point that doesn't leave point 1 above point 0 in both
+// counts and lb is refused with -1 and the stored line stays.
+//--------------------------------------------------------------------
+
+int calSet(int point, unsigned int lb){
+    if(point == 0 ? (AVE_Value >= Cal_Data.count1 || lb >= Cal_Data.lb1)
+                  : (AVE_Value <= Cal_Data.count0 || lb <= Cal_Data.lb0)){
+        return -1;
     }
 
-    // print end
-    UCA1TXBUF = '\n'; // Newline character
-    for (i=0; i<100; i++){
+    HAL_FRAM_OPEN();
+    if(point == 0){
+        Cal_Data.count0 = AVE_Value;
+        Cal_Data.lb0 = lb;
+    }else{
+        Cal_Data.count1 = AVE_Value;
+        Cal_Data.lb1 = lb;
     }
-    UCA1TXBUF = '\r'; // Carriage return (align-L)
+    HAL_FRAM_CLOSE();
+
+    return calInit();
+}
 
+//--------------- End calSet -----------------------------------------
 
-    return 0;
+//--------------- countsToLb -----------------------------------------
+// Filtered ADC counts to Q8 lb, no division
+//--------------------------------------------------------------------
+
+unsigned int countsToLb(unsigned int counts){
+    long lb;
+
+    lb = Cal_Data.lb0 + ((((long)counts - Cal_Data.count0) * calGain) >> 12);
+    if(lb < 0){
+        return 0;
+    }
+    if(lb > 0xFFFF){
+        return 0xFFFF;
+    }
+    return lb;
 }
 
-//--------------- End uartWarning --------------------------------------
+//--------------- End countsToLb -------------------------------------
 
-//--------------- adcAverage ----------------------------------------
-// Implements a rolling average of the past 20 values to reduce adc noise
+//--------------- lbToCounts -----------------------------------------
+// Q8 lb to the nearest ADC count, only used by calInit()
 //--------------------------------------------------------------------
 
-int adcAverage(void){
-    // reset flag
-    adcReady = 0;
+unsigned int lbToCounts(unsigned int lb){
+    long span = Cal_Data.lb1 - Cal_Data.lb0;
+    long counts;
 
-    // remove old value from array
-    total -= ADC_Values[index];
+    counts = ((long)lb - Cal_Data.lb0) * (Cal_Data.count1 - Cal_Data.count0);
+    counts = (counts + ((counts < 0) ? -span : span)/2) / span;     // round
+    counts += Cal_Data.count0;
+    if(counts < 0){
+        return 0;
+    }
+    if(counts > 4095){
+        return 4095;
+    }
+    return counts;
+}
 
-    // put new value into array
-    ADC_Values[index] = ADC_Value;
-    total += ADC_Values[index];
+//--------------- End lbToCounts -------------------------------------
 
-    // update the index to go to oldest value
-    index = (index+1)%20;
+//--------------- forceReport ----------------------------------------
+// Sends the force on the drill over the UART
+//--------------------------------------------------------------------
 
-    // increase the width to the max size of the array
-    if(width<20){
-        width++;
+int forceReport(void){
+    unsigned int lb = countsToLb(AVE_Value);
+
+    // the last report is still going out
+    if(uartQueued(Force_Text)){
+        return -1;
     }
 
-    // calculate the average
-    AVE_Value = total/width;
+    numText(&Force_Text[9], lb >> 8, 3);
+    numText(&Force_Text[13], ((lb & 0xFF) * 100UL) >> 8, 2);
+    if(Force_Text[13] == ' '){
+        Force_Text[13] = '0';       // .05 not . 5
+    }
 
+    uartSend(Force_Text, sizeof(Force_Text)-1);
     return 0;
 }
 
-//--------------- end adcAverage ----------------------------------------
+//--------------- End forceReport ------------------------------------
 
-//--------------- adcStatus ----------------------------------------
-//When the reading is below 1200mV, the Green LED indicates a safe operating condition.
-//When the reading surpasses 1200mV, the LEDs turn off to indicate warning state.
-//When the reading surpasses 1600mV, the Red LED indicates an unsafe operating condition.
+//--------------- setStepMode ----------------------------------------
+// Picks wave, full or half stepping, takes effect on the next move
 //--------------------------------------------------------------------
 
-int adcStatus(void){
-    adcReady = 0;
-    if(AVE_Value>=2560){                      // if over 50lbs, emergency shuoff
-        if(trigger2==1){
-            trigger2=0;
-            dir = 5;
-            position = 0;
-            endof = sizeof(message4)-1;
-            P4IE &= ~BIT1;               // asserts local enable
-            UCA1IE |= UCTXCPTIE;
-            UCA1IFG &= ~UCTXCPTIFG;
-            UCA1TXBUF = message4[position];
-        }
-        P3OUT |= BIT4;
-    }else if(AVE_Value<=2420 && AVE_Value>=2030){            // a4 > 1600mV, the red led turns on
-        // save the time if this is the first unsafe read
-        if(trigger==1){
-            saveTime=1;
-            trigger=0;
-        }
-        P4IE |= BIT1;               // asserts local enable
-        trigger2=1;
-        P1OUT |= BIT0;
-        P6OUT &= ~BIT6;
-        P3OUT &= ~BIT4;
-    }else if(AVE_Value<=1960 && AVE_Value>=1500){           // a2> 1200mV, the led turns off
-        trigger=1;
-        trigger2=1;
-        P4IE |= BIT1;               // asserts local enable
-        P1OUT &= ~BIT0;
-        P6OUT &= ~BIT6;
-        P3OUT &= ~BIT4;
-    }else if(AVE_Value<1450){                  // a2 <= 1200mV, the green led is on
-        trigger=1;
-        trigger2=1;
-        P4IE |= BIT1;               // asserts local enable
-        P1OUT &= ~BIT0;
-        P6OUT |= BIT6;
-        P3OUT &= ~BIT4;
+int setStepMode(int mode){
+    if(mode < STEP_WAVE || mode > STEP_HALF){
+        return -1;
     }
+    stepMode = mode;
     return 0;
 }
 
-//--------------- end adcStatus ----------------------------------------
+//--------------- End setStepMode ------------------------------------
 
-//--------------- switch1Pressed -------------------------------------
-// Rotates the motor CW or CCW by powering one output at a time.
+//--------------- rampInit -------------------------------------------
+// Fills Ramp_Table for constant acceleration from rest, integer only.
+// First period c0 = 0.676 * f * sqrt(2/accel), then each step
+// c(n) = c(n-1) - 2*c(n-1)/(4n+1) until MIN_PERIOD or the table is full.
 //--------------------------------------------------------------------
 
-int switch1Pressed(void){
-    switch1=0;
-    dir = 0;
-    count = 1;
-    position = 0;
-    endof = sizeof(message1)-1;
-    TB0CCR0 = fspeed;             // move slower forward
+int rampInit(void){
+    unsigned long c;
+    unsigned int n;
 
-    UCA1IE |= UCTXCPTIE;
-    UCA1IFG &= ~UCTXCPTIFG;
-    UCA1TXBUF = message1[position];
+    // f*sqrt(2/a) = 100*sqrt(2e8/a) keeps the math in 32 bits
+    c = (676UL * isqrt(200000000UL / accel)) / 10;
+    if(c > 0xFFFF){
+        c = 0xFFFF;
+    }
 
-    for(i=0; i<10000; i=i+1){
-         //prevent overwrite on buffer with delay
-     }
+    for(n=0; n<RAMP_SIZE; n++){
+        if(c < MIN_PERIOD){
+            c = MIN_PERIOD;
+        }
+        Ramp_Table[n] = c;
+        c = c - (2*c)/(4UL*(n+1)+1);
+    }
     return 0;
 }
 
-//--------------- End switch1Pressed ----------------------------------
+//--------------- End rampInit ---------------------------------------
 
-//--------------- switch2 --------------------------------------------
-// Rotates the motor CW or CCW by powering one output at a time.
+//--------------- isqrt ----------------------------------------------
+// Integer square root, bit by bit
 //--------------------------------------------------------------------
 
-int switch2Pressed(void){
-    switch2 = 0;
-    dir = 1;
-    count = 1;
-    position = 0;
-    endof = sizeof(message2)-1;
-    TB0CCR0 = rspeed;              //motor reverse at ~25RPM
+unsigned int isqrt(unsigned long value){
+    unsigned long root = 0;
+    unsigned long bit = 1UL << 30;
+
+    while(bit > value){
+        bit >>= 2;
+    }
+    while(bit != 0){
+        if(value >= root + bit){
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }else{
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+//--------------- End isqrt ------------------------------------------
+
+//--------------- uartWarning ----------------------------------------
+// Outputs message to serial terminal with timestamp of drill press.
+//--------------------------------------------------------------------
+
+int uartWarning(void){
+    unsigned int n;
+    PROF_ENTER();
+
+    // time stamps the log record too
+    if(logActive){
+        for(n=0; n<sizeof(logPending.time); n++){
+            logPending.time[n] = Status_Packet[n];
+        }
+    }
+
+    // the last timestamp is still waiting to go out, don't overwrite it
+    if(uartQueued(Time_Text)){
+        msgDropped++;
+        PROF_EXIT(PROF_WARNING);
+        return -1;
+    }
+
+    // hours:minutes:seconds on month/day/year
+    bcdText(&Time_Text[0], Status_Packet[2]);
+    bcdText(&Time_Text[3], Status_Packet[1]);
+    bcdText(&Time_Text[6], Status_Packet[0]);
+    bcdText(&Time_Text[12], Status_Packet[5]);
+    bcdText(&Time_Text[15], Status_Packet[3]);
+    bcdText(&Time_Text[18], Status_Packet[6]);
 
-    UCA1IE |= UCTXCPTIE;
-    UCA1IFG &= ~UCTXCPTIFG;
-    UCA1TXBUF = message2[position];
+    // print first part of message, then the time
+    uartSend(message3, sizeof(message3)-1);
+    uartSend(Time_Text, sizeof(Time_Text)-1);
 
-    for(i=0; i<10000; i=i+1){
-         //prevent overwrite on buffer with delay
-     }
+    PROF_EXIT(PROF_WARNING);
     return 0;
 }
 
-//--------------- End switch2Pressed ---------------------------------
-
-//--------------- End SUBROUTINES ------------------------------------
+//--------------- End uartWarning --------------------------------------
 
-//--------------------------------------------------------------------
-// INTERRUPT SERVICE ROUTINES
+//--------------- uartSend -------------------------------------------
+// Queues a message and returns right away, ISR_EUSCI_A1 sends it.
+// Only the pointer is queued, the text is not copied. Returns -1 and
+// counts msgDropped if the queue is full.
 //--------------------------------------------------------------------
 
-//--------------- ISR_TBO_CCR0 ----------------------------
-// will step the motor
-#pragma vector=TIMER0_B0_VECTOR
-__interrupt void ISR_TB0_CCR0(void){
-    timeReady = 1;
+int uartSend(const char *data, unsigned int length){
+    unsigned int next = (msgHead+1) & (MSG_SIZE-1);
+
+    if(length == 0){
+        return 0;
+    }
+    if(next == msgTail){
+        msgDropped++;               // full, drop the message
+        return -1;
+    }
+    Msg_Queue[msgHead].data = data;
+    Msg_Queue[msgHead].length = length;
+    msgHead = next;
 
-    TB0CCTL0 &= ~CCIFG;                 // clear ifg
+    HAL_UART_START();               // TXIFG is set while TXBUF is empty, so the ISR starts sending
+    return 0;
 }
-//------------- End ISR_TBO_CCR0 --------------------------
 
-//--------------- ISR_TBO_CCR0 ----------------------------
-// read the ADC value
-#pragma vector=TIMER0_B1_VECTOR
-__interrupt void ISR_TB0_CCR1(void){
-    // Take ADC reading
-    ADCCTL0 |= ADCENC | ADCSC;      // enable and start conversion
-    while((ADCIFG & ADCIFG0)==0);   // wait until conv. is complete
+//--------------- End uartSend ---------------------------------------
+
+//--------------- uartQueued -----------------------------------------
+// Returns 1 if a message using this buffer is still queued or sending
+//--------------------------------------------------------------------
+
+int uartQueued(const char *data){
+    unsigned int n;
 
-    TB0CCTL1 &= ~CCIFG;                 // clear ifg
+    for(n=msgTail; n!=msgHead; n=(n+1) & (MSG_SIZE-1)){
+        if(Msg_Queue[n].data == data){
+            return 1;
+        }
+    }
+    return 0;
 }
-//------------- End ISR_TBO_CCR0 --------------------------
 
-//------- ADC_ISR ----------------------------------------------------
+//--------------- End uartQueued -------------------------------------
 
-//A voltage reading is found from pin 1.4
+//--------------- uartRoom -------------------------------------------
+// Returns how many more messages the queue takes
+//--------------------------------------------------------------------
 
-#pragma vector=ADC_VECTOR
-__interrupt void ADC_ISR(void){
-    ADC_Value = ADCMEM0;                // read adc value
-    adcReady = 1;
+int uartRoom(void){
+    return (msgTail - msgHead - 1) & (MSG_SIZE-1);
 }
-//------- End ADC_ISR ---------------------------
 
-//--------------- EUSCI_A1 ----------------------------
-// ucaifg tells when buffer is ready to transmit new char
-// if all chars sent, then disables irq, otherwise, sends message
-#pragma vector=EUSCI_A1_VECTOR
-__interrupt void ISR_EUSCI_A1(void){
+//--------------- End uartRoom ---------------------------------------
 
-    //Print either message 1 or 2 by iterating through array
-    if(position == endof){
-        UCA1IE &= ~UCTXCPTIE;
-    }else{
-        position++;
-        if(dir==0){
-            UCA1TXBUF = message1[position];
-        }else if(dir==4){
-            UCA1TXBUF = message3[position];
-        }else if(dir==1){
-            UCA1TXBUF = message2[position];
-        }else if(dir==5){
-            UCA1TXBUF = message4[position];
-        }
-    }
+//--------------- bcdText --------------------------------------------
+// Writes a BCD byte from the RTC as two ascii digits
+//--------------------------------------------------------------------
 
-    UCA1IFG &= ~UCTXCPTIFG;
+int bcdText(char *text, char value){
+    text[0] = ((value & 0xF0)>>4) + '0';  // 10s digit
+    text[1] = (value & 0x0F) + '0';       // 1s digit
+    return 0;
 }
-//--------------- End EUSCI_A1 ----------------------------
 
-//--------------- EUSCI_B1 ----------------------------
+//--------------- End bcdText ----------------------------------------
+
+//--------------- uartCommand ----------------------------------------
+// Handles one char typed into the serial terminal
+// p: profiler report, r: reset the profiler, m: move queue
+// g<position><enter>: go to position in half steps, e.g. g-513
+// z: make the current position 0, only while stopped
+// f: force on the drill in lb
+// e: dump the pressure log
+// a: arm a raw capture, it's sent once it triggers and fills
+// s<mode><enter>: step mode for the next moves, 0 wave, 1 full, 2 half
+// l<load><enter>, h<load><enter>: the load on the drill right now is
+// <load> tenths of a lb, sets the low or high calibration point, e.g. l0, h500
+//--------------------------------------------------------------------
 
-// When buffer is ready, this is triggered to read or transmit to RTC
+int uartCommand(char command){
+    int result;
 
-#pragma vector=EUSCI_B1_VECTOR
-__interrupt void EUSCI_B1_I2C_ISR(void){
-    // switch case determines which flag was triggered
-    switch(UCB1IV){
-    case 0x18:                      // id 18: TXIFG0
-        // checks to see if the current date is needed to be put in
-        if(timeSet==1){
-            UCB1TXBUF = 0x03;            // start reading at 0x03 register
-            break;
-        }else{
-            // feeds next part of packet like normal, which puts date in RTC
-            if(Data_Cnt == (sizeof(Start_Packet) -1)){
-                UCB1TXBUF = Start_Packet[Data_Cnt];
-                Data_Cnt = 0;
-            }else{
-                UCB1TXBUF = Start_Packet[Data_Cnt];
-                Data_Cnt++;
+    // digits of a number
+    if(cmdEntry){
+        if(command >= '0' && command <= '9'){
+            if(cmdValue < 100000){
+                cmdValue = cmdValue*10 + (command - '0');
+            }
+            return 0;
+        }
+        if(command == '-' && cmdValue == 0){
+            cmdSign = -1;
+            return 0;
+        }
+        if(command == '\r' || command == '\n'){
+            if(cmdEntry == 'g'){
+                result = gotoMove(cmdSign * cmdValue);
+                if(result == -2){
+                    uartSend(message4, sizeof(message4)-1);
+                }else if(result != 0){
+                    uartSend(message5, sizeof(message5)-1);
+                }
+            }else if(cmdEntry == 's'){
+                setStepMode(cmdSign * cmdValue);
+            }else if(cmdSign > 0 && cmdValue < 2550){
+                if(calSet((cmdEntry == 'h') ? 1 : 0, (cmdValue*256 + 5) / 10) != 0){
+                    uartSend(message8, sizeof(message8)-1);
+                }
             }
         }
+        cmdEntry = 0;
+        return 0;                   // anything else cancels it
+    }
+
+    switch(command){
+    case 'g':
+    case 'l':
+    case 'h':
+    case 's':
+        cmdEntry = command;
+        cmdValue = 0;
+        cmdSign = 1;
         break;
-    case 0x16:                      // id 16: RXIFG0
-        // only happens when pressure is triggered high
-        // recieves current timestamp and saves into Status Packet
-        if(Data_Cnt == (sizeof(Status_Packet) -1)){
-            Status_Packet[Data_Cnt] = UCB1RXBUF;
-            saveTime=0;
-            printWarning=1;
-            Data_Cnt = 0;
-        }else{
-            Status_Packet[Data_Cnt] = UCB1RXBUF;
-            Data_Cnt++;
+    case 'f':
+        forceReport();
+        break;
+    case 'e':
+        logDump();
+        break;
+    case 'a':
+        capArm();
+        break;
+    case 'z':
+        if(dir == 3 && moveQueued() == 0){
+            position = 0;
         }
         break;
+    case 'p':
+        profDump();
+        break;
+    case 'r':
+        profReset();
+        break;
+    case 'm':
+        moveReport();
+        break;
     default:
         break;
     }
+    return 0;
 }
 
-//--------------- End EUSCI_B1 ----------------------------
+//--------------- End uartCommand ------------------------------------
+
+//--------------- profRecord -----------------------------------------
+// Adds one timing to the stats of an ISR or handler
+//--------------------------------------------------------------------
+
+int profRecord(unsigned int id, unsigned int ticks){
+    Profile *p = &Prof_Data[id];
+    unsigned int b = 0;
+    unsigned int t = ticks >> 4;
 
-//--------------- Port4_S1 ----------------------------
-// s1 isr... starts moving forward with half time
-#pragma vector=PORT4_VECTOR
-__interrupt void ISR_Port4_S1(void){
-    P4IFG &= ~BIT1;
-    switch1 = 1;
-    for(i=0; i<10000; i=i+1){
-         //prevent overwrite on buffer with delay
-     }
-}
-//--------------- End Port4_S1 ----------------------------
-
-//--------------- Port2_S2 ----------------------------
-// s2 isr... starts moving backward with quarter time
-#pragma vector=PORT2_VECTOR
-__interrupt void ISR_Port2_S2(void){
-    P2IFG &= ~BIT3;
-    switch2 = 1;
-    for(i=0; i<1000; i=i+1){
-         //prevent overwrite on buffer with delay
-     }
-}
-//--------------- End Port2_S2 ----------------------------
+    if(p->count == 0 || ticks < p->min){
+        p->min = ticks;
+    }
+    if(ticks > p->max){
+        p->max = ticks;
+    }
+    p->count++;
+    p->sum += ticks;
+
+    while(t != 0 && b < PROF_BUCKETS-1){
+        t >>= 1;
+        b++;
+    }
+    p->hist[b]++;
+    return 0;
+}
+
+//--------------- End profRecord -------------------------------------
+
+//--------------- profDump -------------------------------------------
+// Formats the stats into Prof_Text, one line per ISR or handler, and
+// queues them for the UART. Times are in TB2 ticks (MCLK cycles).
+//--------------------------------------------------------------------
+
+int profDump(void){
+    Profile p;
+    char *line;
+    unsigned int n, b;
+
+    // the last report is still going out
+    if(uartQueued(Prof_Text)){
+        return -1;
+    }
+
+    for(n=0; n<PROF_COUNT; n++){
+        // copy with interrupts off so an ISR can't update it half way
+        __disable_interrupt();
+        p = Prof_Data[n];
+        __enable_interrupt();
+
+        line = &Prof_Text[n*PROF_LINE];
+        for(b=0; b<6; b++){
+            line[b] = Prof_Names[n][b];
+        }
+        numText(&line[6], p.min, 6);
+        numText(&line[12], p.max, 6);
+        numText(&line[18], (p.count != 0) ? p.sum/p.count : 0, 6);
+        numText(&line[24], p.count, 10);
+        for(b=0; b<PROF_BUCKETS; b++){
+            numText(&line[34+6*b], p.hist[b], 6);
+        }
+        line[PROF_LINE-2] = '\n';
+        line[PROF_LINE-1] = '\r';
+    }
+
+    uartSend(Prof_Header, sizeof(Prof_Header)-1);
+    uartSend(Prof_Text, sizeof(Prof_Text));
+    return 0;
+}
+
+//--------------- End profDump ---------------------------------------
+
+//--------------- profReset ------------------------------------------
+// Clears the stats
+//--------------------------------------------------------------------
+
+int profReset(void){
+    unsigned int n, b;
+
+    __disable_interrupt();
+    for(n=0; n<PROF_COUNT; n++){
+        Prof_Data[n].min = 0;
+        Prof_Data[n].max = 0;
+        Prof_Data[n].count = 0;
+        Prof_Data[n].sum = 0;
+        for(b=0; b<PROF_BUCKETS; b++){
+            Prof_Data[n].hist[b] = 0;
+        }
+    }
+    __enable_interrupt();
+    return 0;
+}
+
+//--------------- End profReset --------------------------------------
+
+//--------------- numText --------------------------------------------
+// Writes a number right aligned into width chars, '*' if it doesn't fit
+//--------------------------------------------------------------------
+
+int numText(char *text, unsigned long value, unsigned int width){
+    unsigned int n = width;
+
+    do{
+        n--;
+        text[n] = (value % 10) + '0';
+        value /= 10;
+    }while(value != 0 && n > 0);
+
+    if(value != 0){
+        text[0] = '*';
+    }
+    while(n > 0){
+        n--;
+        text[n] = ' ';
+    }
+    return 0;
+}
+
+//--------------- End numText ----------------------------------------
+
+//--------------- adcFilter -----------------------------------------
+// Runs every sample of the block ADC_ISR just finished through the
+// filters in Filter_Chain, AVE_Value is the output for the last sample
+//--------------------------------------------------------------------
+
+int adcFilter(unsigned int block){
+    unsigned int n, stage;
+    PROF_ENTER();
+
+    for(n=0; n<ADC_BLOCK; n++){
+        ADC_Value = ADC_Block[block][n];
+
+        for(stage=0; stage<FILTER_STAGES; stage++){
+            switch(Filter_Chain[stage]){
+            case FILTER_AVERAGE:
+                ADC_Value = averageFilter(ADC_Value);
+                break;
+            case FILTER_MEDIAN:
+                ADC_Value = medianFilter(ADC_Value);
+                break;
+            case FILTER_EMA:
+                ADC_Value = emaFilter(ADC_Value);
+                break;
+            case FILTER_IIR1:
+                ADC_Value = iir1Filter(ADC_Value);
+                break;
+            case FILTER_IIR2:
+                ADC_Value = iir2Filter(ADC_Value);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    AVE_Value = ADC_Value;
+
+    PROF_EXIT(PROF_FILTER);
+    return 0;
+}
+
+//--------------- end adcFilter -----------------------------------------
+
+//--------------- averageFilter -------------------------------------
+// Implements a rolling average of the past ADC_WINDOW values to reduce adc
+// noise. The window is a power of two so the wrap is a mask and the divide
+// a shift, only the first ADC_WINDOW samples after reset need a real divide.
+//--------------------------------------------------------------------
+
+unsigned int averageFilter(unsigned int value){
+    // swap the oldest value in the array for the new one
+    total -= ADC_Values[index];
+    ADC_Values[index] = value;
+    total += value;
+
+    // update the index to go to oldest value
+    index = (index+1) & (ADC_WINDOW-1);
+
+    // increase the width to the max size of the array
+    if(width<ADC_WINDOW){
+        width++;
+        return total/width;         // warm up, window not full yet
+    }
+    return total >> ADC_SHIFT;
+}
+
+//--------------- end averageFilter -------------------------------------
+
+//--------------- medianFilter --------------------------------------
+// Median of the last MEDIAN_SIZE values, a single spike never gets through
+//--------------------------------------------------------------------
+
+unsigned int medianFilter(unsigned int value){
+    unsigned int sorted[MEDIAN_SIZE];
+    unsigned int n, m, v;
+
+    Median_Values[medianIndex] = value;
+    medianIndex++;
+    if(medianIndex == MEDIAN_SIZE){
+        medianIndex = 0;
+    }
+    if(medianWidth<MEDIAN_SIZE){
+        medianWidth++;
+    }
+
+    // insertion sort, only a handful of values
+    for(n=0; n<medianWidth; n++){
+        v = Median_Values[n];
+        for(m=n; m>0 && sorted[m-1]>v; m--){
+            sorted[m] = sorted[m-1];
+        }
+        sorted[m] = v;
+    }
+    return sorted[medianWidth>>1];
+}
+
+//--------------- end medianFilter --------------------------------------
+
+//--------------- emaFilter -----------------------------------------
+// Exponential moving average, y += (x-y) >> EMA_SHIFT, shifts only
+//--------------------------------------------------------------------
+
+unsigned int emaFilter(unsigned int value){
+    if(emaPrimed == 0){
+        emaPrimed = 1;
+        emaState = (unsigned long)value << EMA_SHIFT;
+    }
+    emaState = emaState - (emaState >> EMA_SHIFT) + value;
+    return emaState >> EMA_SHIFT;
+}
+
+//--------------- end emaFilter -----------------------------------------
+
+//--------------- iir1Filter ----------------------------------------
+// First order low pass, y += alpha*(x-y) with alpha in Q15
+//--------------------------------------------------------------------
+
+unsigned int iir1Filter(unsigned int value){
+    long x = (long)value << 4;
+
+    if(iir1Primed == 0){
+        iir1Primed = 1;
+        iir1State = x;
+    }
+    iir1State += ((x - iir1State) * IIR1_ALPHA) >> 15;
+    return iir1State >> 4;
+}
+
+//--------------- end iir1Filter ----------------------------------------
+
+//--------------- iir2Filter ----------------------------------------
+// Second order Butterworth low pass, direct form I with Q14 coefficients
+//--------------------------------------------------------------------
+
+unsigned int iir2Filter(unsigned int value){
+    long acc;
+
+    if(iir2Primed == 0){
+        iir2Primed = 1;
+        Iir2_X[0] = Iir2_X[1] = value;
+        Iir2_Y[0] = Iir2_Y[1] = (long)value << 2;
+    }
+
+    acc = ((long)IIR2_B0*value + (long)IIR2_B1*Iir2_X[0] + (long)IIR2_B2*Iir2_X[1]) << 2;
+    acc -= (long)IIR2_A1*Iir2_Y[0] + (long)IIR2_A2*Iir2_Y[1];
+    acc >>= 14;
+    if(acc < 0){
+        acc = 0;                    // ringing on a fast drop, adc can't go negative
+    }
+
+    Iir2_X[1] = Iir2_X[0];
+    Iir2_X[0] = value;
+    Iir2_Y[1] = Iir2_Y[0];
+    Iir2_Y[0] = acc;
+    return acc >> 2;
+}
+
+//--------------- end iir2Filter ----------------------------------------
+
+//--------------- adcStatus ----------------------------------------
+// Moves the pressure zone up past every enter level the reading reached,
+// or down past every exit level it dropped under, then runs zoneEnter()
+// if the zone changed. Between the levels the zone holds.
+//--------------------------------------------------------------------
+
+int adcStatus(void){
+    unsigned int from = zone;
+    PROF_ENTER();
+
+    while(zone < ZONE_CUTOFF && AVE_Value >= Zone_Enter[zone+1]){
+        zone++;
+    }
+    while(zone > ZONE_SAFE && AVE_Value < Zone_Exit[zone]){
+        zone--;
+    }
+
+    if(zone != from){
+        zoneTime = 0;
+        zoneEnter(from);
+    }
+    zoneTime += ADC_BLOCK;              // one call per block
+    Zone_Dwell[zone] += ADC_BLOCK;
+
+    if(logActive){
+        if(AVE_Value > logPending.peak){
+            logPending.peak = AVE_Value;
+        }
+        if(zone > logPending.zone){
+            logPending.zone = zone;
+        }
+        if(logPending.duration <= 0xFFFF - ADC_BLOCK){
+            logPending.duration += ADC_BLOCK;
+        }
+    }
+
+    PROF_EXIT(PROF_STATUS);
+    return 0;
+}
+
+//--------------- end adcStatus ----------------------------------------
+
+//--------------- zoneEnter ------------------------------------------
+// Sets the LEDs, alarm and forward lockout for the new zone.
+// Going up into unsafe or cutoff from below stamps the time over UART,
+// going into cutoff stops a forward move and drops the queue.
+//--------------------------------------------------------------------
+
+int zoneEnter(unsigned int from){
+    const Zone *z = &Zone_Table[zone];
+
+    HAL_RED_LED(z->red);
+    HAL_GREEN_LED(z->green);
+    HAL_ALARM(z->alarm || tripped);
+    sw1Enabled = z->sw1;
+
+    if(zone >= ZONE_UNSAFE && from < ZONE_UNSAFE){
+        saveTime=1;                     // save the time of the first unsafe read
+        rtcWarn=1;
+        rtcTries=0;
+        rtcRead();
+        logStart();
+    }else if(zone < ZONE_UNSAFE && from >= ZONE_UNSAFE){
+        logEnd();
+    }
+    if(zone == ZONE_CUTOFF){            // if over 50lbs, emergency shutoff
+        if(dir==0){
+            stopMove();                 // stop feeding forward, a retract can keep going
+        }else{
+            moveFlush();                // but nothing queued behind it
+        }
+        uartSend(message4, sizeof(message4)-1);
+    }
+    return 0;
+}
+
+//--------------- End zoneEnter --------------------------------------
+
+//--------------- logStart -------------------------------------------
+// Starts a log record, uartWarning() fills in the time once the RTC
+// read is back
+//--------------------------------------------------------------------
+
+int logStart(void){
+    unsigned int n;
+
+    for(n=0; n<sizeof(logPending.time); n++){
+        logPending.time[n] = 0;
+    }
+    logPending.zone = zone;
+    logPending.peak = AVE_Value;
+    logPending.duration = 0;
+    logPending.reserved = 0;
+    logActive = 1;
+    return 0;
+}
+
+//--------------- End logStart ---------------------------------------
+
+//--------------- logEnd ---------------------------------------------
+// Packs the finished record into the FRAM ring, overwriting the oldest
+// once it's full. LOG_BYTES of writes, so it doesn't hold up the main loop.
+//--------------------------------------------------------------------
+
+int logEnd(void){
+    unsigned char *at;
+    unsigned int n;
+
+    logActive = 0;
+    logPending.seq = logSeq;
+
+    HAL_FRAM_OPEN();
+    at = Log_Ring[logSeq & (LOG_SIZE-1)];
+    for(n=0; n<sizeof(logPending.time); n++){
+        *at++ = logPending.time[n];
+    }
+    *at++ = logPending.zone;
+    at = packWord(at, logPending.peak);
+    at = packWord(at, logPending.duration);
+    at = packWord(at, logPending.seq);
+    packWord(at, logPending.reserved);
+    logSeq++;                                   // only after the record is in
+    HAL_FRAM_CLOSE();
+    return 0;
+}
+
+//--------------- End logEnd -----------------------------------------
+
+//--------------- logDump --------------------------------------------
+// Sends the records oldest first in a FRAME_LOG, straight out of FRAM
+//--------------------------------------------------------------------
+
+int logDump(void){
+    unsigned int head = logSeq & (LOG_SIZE-1);
+    unsigned int count = (logSeq < LOG_SIZE) ? logSeq : LOG_SIZE;
+    Message parts[2];
+
+    // the last dump is still going out
+    if(frameBusy(&Log_Frame)){
+        return -1;
+    }
+
+    if(count == LOG_SIZE){
+        // full, oldest is at head, the second part is empty when head is 0
+        parts[0].data = (const char *)Log_Ring[head];
+        parts[0].length = (LOG_SIZE-head) * LOG_BYTES;
+        parts[1].data = (const char *)Log_Ring;
+        parts[1].length = head * LOG_BYTES;
+    }else{
+        parts[0].data = (const char *)Log_Ring;
+        parts[0].length = count * LOG_BYTES;
+        parts[1].data = (const char *)Log_Ring;
+        parts[1].length = 0;
+    }
+    return frameSend(&Log_Frame, FRAME_LOG, parts, 2);
+}
+
+//--------------- End logDump ----------------------------------------
+
+//--------------- capArm ---------------------------------------------
+// Starts a raw capture, ignored while one is running or still going out
+//--------------------------------------------------------------------
+
+int capArm(void){
+    if(capState != CAP_IDLE || frameBusy(&Cap_Frame)){
+        return -1;
+    }
+
+    capLevel = lbToCounts(CAP_LEVEL);
+    capWrite = 0;
+    capFill = 0;
+    capSkip = 0;
+    capLast = 0xFFFF;               // no trigger on the very first sample
+    capState = CAP_ARMED;           // ADC_ISR takes it from here
+    return 0;
+}
+
+//--------------- End capArm -----------------------------------------
+
+//--------------- capSend --------------------------------------------
+// Handles EV_CAPTURE, sends Cap_Head then the samples oldest first in
+// a FRAME_CAPTURE, straight out of FRAM where they're already packed. The
+// capture is only done with once the frame is queued.
+//--------------------------------------------------------------------
+
+int capSend(void){
+    Message parts[3];
+    unsigned char *at;
+
+    if(capState != CAP_DONE){
+        return 0;                   // already sent, a retry came in late
+    }
+    at = packWord(Cap_Head, CAP_SIZE);
+    at = packWord(at, CAP_PRE);
+    at = packWord(at, SAMPLE_PERIOD*CAP_DIVIDE);
+    packWord(at, capLevel);
+    parts[0].data = (const char *)Cap_Head;
+    parts[0].length = CAP_HEAD_BYTES;
+    parts[1].data = (const char *)Cap_Buffer[capWrite];
+    parts[1].length = (CAP_SIZE-capWrite) * sizeof(Cap_Buffer[0]);
+    parts[2].data = (const char *)Cap_Buffer;
+    parts[2].length = capWrite * sizeof(Cap_Buffer[0]);
+
+    if(frameSend(&Cap_Frame, FRAME_CAPTURE, parts, 3) != 0){
+        return -1;                  // still CAP_DONE, tickTask posts it again
+    }
+    capState = CAP_IDLE;
+    return 0;
+}
+
+//--------------- End capSend ----------------------------------------
+
+//--------------- frameSend ------------------------------------------
+// Queues a frame around the parts, which make up the payload in order.
+// The whole frame is queued or none of it, so a full UART queue never
+// leaves half a frame on the line.
+//--------------------------------------------------------------------
+
+int frameSend(Frame *frame, unsigned int type, const Message *parts, unsigned int count){
+    unsigned int n, k, length = 0;
+
+    if(uartRoom() < count+2){
+        msgDropped++;
+        return -1;
+    }
+
+    for(n=0; n<count; n++){
+        length += parts[n].length;
+    }
+    frame->head[0] = FRAME_SYNC;
+    frame->head[1] = type;
+    frame->head[2] = length & 0xFF;
+    frame->head[3] = length >> 8;
+
+    HAL_CRC_START(0xFFFF);
+    for(k=1; k<4; k++){
+        HAL_CRC_BYTE(frame->head[k]);
+    }
+    for(n=0; n<count; n++){
+        for(k=0; k<parts[n].length; k++){
+            HAL_CRC_BYTE(parts[n].data[k]);
+        }
+    }
+    packWord(frame->crc, HAL_CRC_RESULT());
+
+    uartSend((const char *)frame->head, sizeof(frame->head));
+    for(n=0; n<count; n++){
+        uartSend(parts[n].data, parts[n].length);
+    }
+    uartSend((const char *)frame->crc, sizeof(frame->crc));
+    return 0;
+}
+
+//--------------- End frameSend --------------------------------------
+
+//--------------- packWord -------------------------------------------
+// Writes the low 16 bits of value little endian, returns the next byte
+//--------------------------------------------------------------------
+
+unsigned char *packWord(unsigned char *at, unsigned int value){
+    at[0] = value & 0xFF;
+    at[1] = (value >> 8) & 0xFF;
+    return at + 2;
+}
+
+//--------------- End packWord ---------------------------------------
+
+//--------------- packLong -------------------------------------------
+// Writes value as 32 bits little endian, returns the next byte
+//--------------------------------------------------------------------
+
+unsigned char *packLong(unsigned char *at, long value){
+    at = packWord(at, (unsigned long)value & 0xFFFF);
+    return packWord(at, ((unsigned long)value >> 16) & 0xFFFF);
+}
+
+//--------------- End packLong ---------------------------------------
+
+//--------------- frameBusy ------------------------------------------
+// Returns 1 until the last frame sent with this Frame is out, the CRC
+// is always the last part to go
+//--------------------------------------------------------------------
+
+int frameBusy(const Frame *frame){
+    return uartQueued((const char *)frame->crc);
+}
+
+//--------------- End frameBusy --------------------------------------
+
+//--------------- statusSend -----------------------------------------
+// Handles EV_STATUS, sends pressure, zone, motor and time in a
+// FRAME_STATUS and starts an RTC read so the next one has a fresh time
+//--------------------------------------------------------------------
+
+int statusSend(void){
+    Message part;
+    unsigned char *at;
+    unsigned int n;
+    long now;
+
+    // the last one is still going out, skip this one
+    if(frameBusy(&Status_Frame)){
+        return -1;
+    }
+
+    __disable_interrupt();              // 32 bits, ISR_TB3_CCR0 can't step in between
+    now = position;
+    __enable_interrupt();
+    at = packWord(Status_Data, countsToLb(AVE_Value));
+    at = packWord(at, AVE_Value);
+    *at++ = zone;
+    *at++ = dir;
+    at = packLong(at, now);
+    at = packWord(at, stepsLeft);
+    for(n=0; n<sizeof(Status_Packet); n++){
+        *at++ = Status_Packet[n];
+    }
+    *at = moveQueued();
+
+    part.data = (const char *)Status_Data;
+    part.length = STATUS_BYTES;
+    frameSend(&Status_Frame, FRAME_STATUS, &part, 1);
+
+    if(i2cState == I2C_IDLE && saveTime == 0){
+        rtcRead();
+    }
+    return 0;
+}
+
+//--------------- End statusSend -------------------------------------
+
+//--------------- switch1Pressed -------------------------------------
+// Rotates the motor CW or CCW by powering one output at a time.
+//--------------------------------------------------------------------
+
+int switch1Pressed(void){
+    int result = startMove(0, fspin, frpm);     // move slower forward
+
+    if(result == -2){
+        uartSend(message4, sizeof(message4)-1);
+        return -1;
+    }
+    if(result != 0){
+        uartSend(message5, sizeof(message5)-1);
+        return -1;
+    }
+
+    uartSend(message1, sizeof(message1)-1);
+    return 0;
+}
+
+//--------------- End switch1Pressed ----------------------------------
+
+//--------------- switch2 --------------------------------------------
+// Rotates the motor CW or CCW by powering one output at a time.
+//--------------------------------------------------------------------
+
+int switch2Pressed(void){
+    if(startMove(1, rspin, rrpm) != 0){     //motor reverse at ~25RPM
+        uartSend(message5, sizeof(message5)-1);
+        return -1;
+    }
+
+    uartSend(message2, sizeof(message2)-1);
+    return 0;
+}
+
+//--------------- End switch2Pressed ---------------------------------
+
+//--------------- adcBlock -------------------------------------------
+// Handles EV_ADC, filters the new block then updates the pressure status
+//--------------------------------------------------------------------
+
+int adcBlock(unsigned int block){
+    adcFilter(block);
+    adcQueued--;                    // ADC_ISR may reuse the block now
+    adcStatus();
+    return 0;
+}
+
+//--------------- End adcBlock ---------------------------------------
+
+//--------------- postEvent ------------------------------------------
+// Pushes an event for main(), only call from an ISR. The ISR still has to
+// wake main with __bic_SR_register_on_exit(LPM0_bits).
+// Returns -1 and counts evDropped if the queue is full.
+//--------------------------------------------------------------------
+
+int postEvent(unsigned int type, unsigned int data){
+    unsigned int next = (evHead+1) & (EV_SIZE-1);
+
+    if(next == evTail){
+        evDropped++;
+        return -1;
+    }
+    Event_Queue[evHead].type = type;
+    Event_Queue[evHead].data = data;
+    evHead = next;                  // publish after the payload is written
+    return 0;
+}
+
+//--------------- End postEvent --------------------------------------
+
+//--------------- getEvent -------------------------------------------
+// Takes the oldest event off the queue, only call from main(). Returns
+// -1 if the queue is empty. ISRs can post while it runs, the slot it
+// reads is never written until evTail has moved past it.
+//--------------------------------------------------------------------
+
+int getEvent(Event *ev){
+    unsigned int tail = evTail;
+
+    if(tail == evHead){
+        return -1;
+    }
+    *ev = Event_Queue[tail];
+    evTail = (tail+1) & (EV_SIZE-1);
+    return 0;
+}
+
+//--------------- End getEvent ---------------------------------------
+
+//--------------- tickTask -------------------------------------------
+// The 1 ms tick, only call from ISR_TB3_CCRn. Debounces s1 (forward)
+// and s2 (reverse), posts press and release once the integrator settles
+// and a long press once a switch has been held SW_LONG ms, also times
+// the status frames and capture retries. Returns 1 if it posted an event.
+//--------------------------------------------------------------------
+
+int tickTask(void){
+    unsigned int n, down, posted = 0;
+    Switch *sw;
+
+    for(n=0; n<2; n++){
+        sw = &Switches[n];
+        down = (n == 0) ? HAL_SW1() : HAL_SW2();
+
+        if(down){
+            if(sw->level < SW_DEBOUNCE){
+                sw->level++;
+            }
+        }else if(sw->level > 0){
+            sw->level--;
+        }
+
+        if(!sw->pressed && sw->level == SW_DEBOUNCE){
+            sw->pressed = 1;
+            sw->held = 0;
+            if(n != 0 || sw1Enabled){
+                postEvent(EV_SWITCH, SW_PRESS | (n+1));
+                posted = 1;
+            }
+        }else if(sw->pressed && sw->level == 0){
+            sw->pressed = 0;
+            postEvent(EV_SWITCH, SW_RELEASE | (n+1));
+            posted = 1;
+        }else if(sw->pressed && sw->held < SW_LONG){
+            sw->held++;
+            if(sw->held == SW_LONG){
+                postEvent(EV_SWITCH, SW_LONGPRESS | (n+1));
+                posted = 1;
+            }
+        }
+    }
+
+    // status frame timer
+    if(TELEMETRY_MS != 0 && ++telemetryTick >= TELEMETRY_MS){
+        telemetryTick = 0;
+        postEvent(EV_STATUS, 0);
+        posted = 1;
+    }
+
+    // a capture frame the UART queue had no room for
+    if(capState == CAP_DONE && ++capRetry >= CAP_RETRY){
+        capRetry = 0;
+        postEvent(EV_CAPTURE, 0);
+        posted = 1;
+    }
+    return posted;
+}
+
+//--------------- End tickTask ---------------------------------------
+
+//--------------- End SUBROUTINES ------------------------------------
+
+//--------------------------------------------------------------------
+// INTERRUPT SERVICE ROUTINES
+//--------------------------------------------------------------------
+
+//--------------- ISR_TB3_CCR0 ----------------------------
+// will step the motor, one table lookup and one write to P3OUT per step,
+// then sets the deadline for the next step from the ramp
+// when a move ends the next queued one is loaded on the same tick,
+// while stopped it checks the queue every Ramp_Table[0] counts.
+// A forward move isn't loaded at cutoff or while tripped, main may have
+// queued it just before the trip or cutoff cleared the queue.
+#pragma vector=TIMER3_B0_VECTOR
+__interrupt void ISR_TB3_CCR0(void){
+    unsigned int n;
+    Move *m;
+    PROF_ENTER();
+
+    // a step past a soft limit ends the move and everything queued
+    if(stepsLeft > 0 && (position + stepDelta > posMax || position + stepDelta < posMin)){
+        stepsLeft = 0;
+        moveTail = moveHead;
+        postEvent(EV_LIMIT, dir);
+        __bic_SR_register_on_exit(LPM0_bits);   // wake main
+    }
+
+    if(stepsLeft > 0){
+        phase = (phase + stepDelta) & 7;
+        HAL_COILS(Phase_Table[phase]);
+        position += stepDelta;
+        stepsLeft--;
+        stepIndex++;
+        if(stepsLeft > 0){
+            // speed up from the start, slow down into the end
+            n = (stepIndex < stepsLeft) ? stepIndex : stepsLeft-1;
+            HAL_STEP_PERIOD((n < rampLen) ? Ramp_Table[n] : cruisePeriod);
+        }
+    }
+
+    if(stepsLeft == 0){
+        while(moveTail != moveHead && Move_Queue[moveTail].dir == 0 &&
+              (zone == ZONE_CUTOFF || tripped)){
+            moveTail = (moveTail+1) & (MOVE_SIZE-1);    // same rule as queueMove()
+        }
+        if(moveTail != moveHead){
+            m = &Move_Queue[moveTail];
+            if(m->parity >= 0){
+                n = (phase & ~1) | m->parity;
+                position += (int)n - (int)phase;    // the coils move half a step
+                phase = n;
+            }
+            stepDelta = m->delta;
+            rampLen = m->rampLen;
+            cruisePeriod = m->cruise;
+            stepIndex = 0;
+            dir = m->dir;
+            HAL_STEP_PERIOD((rampLen > 0) ? Ramp_Table[0] : cruisePeriod);
+            stepsLeft = m->steps;
+            moveTail = (moveTail+1) & (MOVE_SIZE-1);
+        }else{
+            dir = 3;                        // move done
+            HAL_STEP_PERIOD(Ramp_Table[0]);
+        }
+    }
+
+    TB3CCTL0 &= ~CCIFG;                 // clear ifg
+    PROF_EXIT(PROF_STEP);
+}
+//------------- End ISR_TB3_CCR0 --------------------------
+
+//--------------- ISR_TB3_CCRn ----------------------------
+// the rest of the TB3 deadlines, TB3IV says which one is due
+// and reading it clears that flag
+#pragma vector=TIMER3_B1_VECTOR
+__interrupt void ISR_TB3_CCRn(void){
+    PROF_ENTER();
+
+    switch(TB3IV){
+
+    case 0x04:                          // id 04: CCR2, 1 ms tick
+        TB3CCR2 += TICK_PERIOD;
+        if(tickTask()){
+            __bic_SR_register_on_exit(LPM0_bits);   // wake main
+        }
+        break;
+    case 0x06:                          // id 06: CCR3, I2C timeout
+        HAL_I2C_TIMEOUT_OFF();          // one shot
+        // give up on an I2C transfer that never finished
+        if(i2cState != I2C_IDLE){
+            HAL_I2C_STOP_AT_OFF();
+            HAL_I2C_STOP();
+            i2cFail();
+            i2cState = I2C_IDLE;
+            if(saveTime == 1){
+                postEvent(EV_RTC, 0);   // retry the read
+                __bic_SR_register_on_exit(LPM0_bits);
+            }
+        }
+        break;
+    case 0x08:                          // id 08: CCR4, single byte read STOP
+        HAL_I2C_STOP_AT_OFF();          // one shot
+        if(i2cState == I2C_READ){
+            if(HAL_I2C_STARTING()){
+                HAL_I2C_STOP_AT(I2C_STOP_POLL);     // not yet, look again
+            }else{
+                HAL_I2C_STOP();         // NACK and STOP after the byte coming in
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    PROF_EXIT(PROF_TICK);
+}
+//------------- End ISR_TB3_CCRn --------------------------
+
+
+//------- ADC_ISR ----------------------------------------------------
+
+//A voltage reading is found from pin 1.4
+//Stores the sample, hands the block to the main loop once it is full
+//While a capture is running the raw sample also goes to Cap_Buffer
+
+#pragma vector=ADC_VECTOR
+__interrupt void ADC_ISR(void){
+    unsigned int raw, cfg;
+    PROF_ENTER();
+
+    raw = ADCMEM0;                      // read adc value
+    ADC_Block[adcWrite][adcFill] = raw;
+    adcFill++;
+
+    if((capState == CAP_ARMED || capState == CAP_POST) && ++capSkip >= CAP_DIVIDE){
+        capSkip = 0;
+        cfg = HAL_FRAM_STATE();         // main may be mid write, put it back as it was
+        HAL_FRAM_OPEN();
+        Cap_Buffer[capWrite][0] = raw & 0xFF;
+        Cap_Buffer[capWrite][1] = raw >> 8;
+        HAL_FRAM_RESTORE(cfg);
+        capWrite = (capWrite+1) & (CAP_SIZE-1);
+        if(capFill < CAP_SIZE){
+            capFill++;
+        }
+
+        if(capState == CAP_ARMED){
+            // rising through the level with enough samples before it
+            if(capFill > CAP_PRE && capLast < capLevel && raw >= capLevel){
+                capState = CAP_POST;
+                capLeft = CAP_SIZE - CAP_PRE - 1;   // trigger sample lands at CAP_PRE
+            }
+        }else if(--capLeft == 0){
+            capState = CAP_DONE;
+            postEvent(EV_CAPTURE, 0);
+            __bic_SR_register_on_exit(LPM0_bits);   // wake main
+        }
+        capLast = raw;
+    }
+
+    if(adcFill == ADC_BLOCK){
+        if(postEvent(EV_ADC, adcWrite) == 0){
+            adcQueued++;
+        }
+        if(adcQueued >= ADC_BLOCKS){
+            adcOverrun++;               // next block is still waiting on main, it gets overwritten
+        }
+        adcWrite = (adcWrite+1) & (ADC_BLOCKS-1);
+        adcFill = 0;
+        __bic_SR_register_on_exit(LPM0_bits);   // wake main
+    }
+    PROF_EXIT(PROF_ADC);
+}
+//------- End ADC_ISR ---------------------------
+
+//--------------- ECOMP0_ISR ----------------------------
+// pressure went over TRIP_LEVEL, cuts the coils and sounds the
+// alarm first, then drops the move and everything queued.
+// Stops a retract too, the ADC path decides what runs after.
+// Forward moves stay locked out until the pressure falls back under
+// the level, then the alarm goes back to what the zone wants.
+#pragma vector=ECOMP0_ECOMP1_VECTOR
+__interrupt void ECOMP0_ISR(void){
+    PROF_ENTER();
+
+    switch(CP0IV){
+    case 0x02:                          // id 02: CPIFG, rising edge
+        tripped = 1;
+        HAL_COILS(0);
+        HAL_ALARM(1);
+        stepsLeft = 0;
+        moveTail = moveHead;
+        dir = 3;
+        postEvent(EV_TRIP, 0);
+        __bic_SR_register_on_exit(LPM0_bits);   // wake main
+        break;
+    case 0x04:                          // id 04: CPIIFG, falling edge
+        tripped = 0;
+        HAL_ALARM(Zone_Table[zone].alarm);
+        break;
+    default:
+        break;
+    }
+    PROF_EXIT(PROF_TRIP);
+}
+//------- End ECOMP0_ISR ---------------------------
+
+//--------------- EUSCI_A1 ----------------------------
+// ucaifg tells when buffer is ready to transmit new char
+// if no message is queued, then disables irq, otherwise, sends next char
+// received chars go to the main loop as commands
+#pragma vector=EUSCI_A1_VECTOR
+__interrupt void ISR_EUSCI_A1(void){
+    PROF_ENTER();
+
+    switch(UCA1IV){
+    case 0x02:                          // id 02: RXIFG
+        postEvent(EV_COMMAND, UCA1RXBUF);
+        __bic_SR_register_on_exit(LPM0_bits);   // wake main
+        break;
+    case 0x04:                          // id 04: TXIFG
+        if(msgTail == msgHead){
+            // nothing left, uartSend re-enables. Reading UCA1IV cleared
+            // TXIFG but TXBUF is empty, so set it back or the next
+            // uartSend never gets an interrupt
+            UCA1IFG |= UCTXIFG;
+            UCA1IE &= ~UCTXIE;
+        }else{
+            UCA1TXBUF = Msg_Queue[msgTail].data[msgSent];  // writing TXBUF clears TXIFG
+            msgSent++;
+            if(msgSent == Msg_Queue[msgTail].length){
+                msgSent = 0;
+                msgTail = (msgTail+1) & (MSG_SIZE-1);
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    PROF_EXIT(PROF_UART);
+}
+//--------------- End EUSCI_A1 ----------------------------
+
+//--------------- EUSCI_B1 ----------------------------
+
+// Runs the transfers started by i2cTransfer()
+
+#pragma vector=EUSCI_B1_VECTOR
+__interrupt void EUSCI_B1_I2C_ISR(void){
+    PROF_ENTER();
+
+    // switch case determines which flag was triggered
+    switch(UCB1IV){
+    case 0x04:                      // id 04: NACKIFG
+        // RTC did not answer, release the bus
+        HAL_I2C_STOP();
+        i2cFail();
+        i2cState = I2C_FAIL;
+        break;
+    case 0x08:                      // id 08: STPIFG
+        // STPIFG is ahead of RXIFG0 in UCB1IV, so when this ISR ran late
+        // the last byte can still be sitting in RXBUF
+        if(i2cState == I2C_READ && (UCB1IFG & UCRXIFG0) && Data_Cnt < i2cRxLen){
+            i2cRx[Data_Cnt] = UCB1RXBUF;
+            Data_Cnt++;
+        }
+        // transfer is over, tell whoever started it if every byte moved
+        if(i2cEvent != I2C_NO_EVENT &&
+           ((i2cState == I2C_WRITE && Data_Cnt == i2cTxLen) ||
+            (i2cState == I2C_READ && Data_Cnt == i2cRxLen))){
+            postEvent(i2cEvent, 0);
+        }
+        HAL_I2C_TIMEOUT_OFF();
+        HAL_I2C_STOP_AT_OFF();
+        i2cState = I2C_IDLE;
+        if(saveTime == 1){
+            postEvent(EV_RTC, 0);   // a read was asked for while the bus was busy
+        }
+        __bic_SR_register_on_exit(LPM0_bits);   // wake main
+        break;
+    case 0x16:                      // id 16: RXIFG0
+        // saves the next byte, STOP goes with the byte after the next to last
+        if(Data_Cnt < i2cRxLen){
+            i2cRx[Data_Cnt] = UCB1RXBUF;
+            Data_Cnt++;
+        }else{
+            UCB1RXBUF;
+        }
+        if(i2cRxLen > 1 && Data_Cnt == i2cRxLen - 1){
+            HAL_I2C_STOP();         // NACK and STOP after the last byte
+        }
+        break;
+    case 0x18:                      // id 18: TXIFG0
+        if(i2cState != I2C_WRITE){
+            break;
+        }
+        if(Data_Cnt < i2cTxLen){
+            // feeds next byte of the write
+            UCB1TXBUF = i2cTx[Data_Cnt];
+            Data_Cnt++;
+        }else if(i2cRxLen > 0){
+            // write is out, repeated start into Rx mode
+            Data_Cnt = 0;
+            i2cState = I2C_READ;
+            i2cReadStart();
+        }else{
+            HAL_I2C_STOP();
+            UCB1IFG &= ~UCTXIFG0;
+        }
+        break;
+    case 0x1C:                      // id 1C: CLTOIFG
+        // clock held low too long
+        HAL_I2C_STOP();
+        i2cFail();
+        i2cState = I2C_FAIL;
+        break;
+    default:
+        break;
+    }
+    PROF_EXIT(PROF_I2C);
+}
+
+//--------------- End EUSCI_B1 ----------------------------
 
 //--------------- End ISRs --------------------------------
@@ -0,0 +1,124 @@
+//--------------------------------------------------------------------
+// Noise and spectrum of a raw capture
+//--------------------------------------------------------------------
+// Reads what the firmware sent on the UART, from a file or stdin, and
+// for every capture frame ("a" on the terminal) looks at the samples
+// before the trigger. A straight line is fitted through them so a slow
+// ramp in the pressure doesn't count as noise, what's left over gives
+// the noise statistics. Its spectrum is a Hann windowed DFT, reported
+// as the rms in SPECTRUM_BANDS equal bands up to half the sample rate
+// and the strongest single bin. The exit code is the number of frames
+// with a bad CRC or a capture payload that isn't the layout.
+//
+//     capture [line.bin]
+//--------------------------------------------------------------------
+
+#include <stdio.h>
+#include <math.h>
+#include "wire.h"
+
+#define SPECTRUM_BANDS 16
+#define PI 3.14159265358979
+
+static double Residual[WIRE_MAX / 2];
+static double Power[WIRE_MAX / 4 + 1];
+
+static void report(const unsigned char *payload, const WireCapture *h){
+    unsigned int n = h->pre, k, i, band, peak = 1;
+    double rate = 1e6 / h->period, mx = 0, my = 0, sxx = 0, sxy = 0;
+    double slope, mean = 0, var = 0, lo = 1e9, hi = -1e9, w, re, im, sum;
+
+    printf("capture           %u samples at %.0f Hz, %u before the trigger, level %u\n",
+           h->count, rate, h->pre, h->level);
+    if(n < 16){
+        printf("noise             too few samples before the trigger\n");
+        return;
+    }
+
+    // least squares line through the pre trigger samples
+    for(i=0; i<n; i++){
+        mx += i;
+        my += wireSample(payload, i);
+    }
+    mx /= n;
+    my /= n;
+    for(i=0; i<n; i++){
+        sxx += (i - mx) * (i - mx);
+        sxy += (i - mx) * (wireSample(payload, i) - my);
+    }
+    slope = sxy / sxx;
+    for(i=0; i<n; i++){
+        Residual[i] = wireSample(payload, i) - (my + slope * (i - mx));
+        mean += Residual[i];
+        lo = (Residual[i] < lo) ? Residual[i] : lo;
+        hi = (Residual[i] > hi) ? Residual[i] : hi;
+    }
+    mean /= n;
+    for(i=0; i<n; i++){
+        var += (Residual[i] - mean) * (Residual[i] - mean);
+    }
+    var /= n - 1;
+    printf("trend             %.1f counts, %+.3f counts/sample\n", my, slope);
+    printf("noise             %.2f counts rms, %.1f..%+.1f counts, %.1f peak to peak\n",
+           sqrt(var), lo, hi, hi - lo);
+
+    // one sided power per bin, Hann window, scaled so the bins sum to the variance
+    for(k=0; k<=n/2; k++){
+        re = 0;
+        im = 0;
+        for(i=0; i<n; i++){
+            w = 0.5 - 0.5 * cos(2*PI*i / n);
+            re += w * Residual[i] * cos(2*PI*k*i / n);
+            im -= w * Residual[i] * sin(2*PI*k*i / n);
+        }
+        Power[k] = (re*re + im*im) / (0.375 * n * n) * ((k == 0 || k == n/2) ? 1 : 2);
+        if(k > 0 && Power[k] > Power[peak]){
+            peak = k;
+        }
+    }
+    printf("spectrum          band Hz            rms counts\n");
+    for(band=0; band<SPECTRUM_BANDS; band++){
+        sum = 0;
+        for(k=1 + band*(n/2)/SPECTRUM_BANDS; k<=(band+1)*(n/2)/SPECTRUM_BANDS; k++){
+            sum += Power[k];
+        }
+        printf("                  %6.1f..%6.1f   %6.3f\n", band * rate / 2 / SPECTRUM_BANDS,
+               (band+1) * rate / 2 / SPECTRUM_BANDS, sqrt(sum));
+    }
+    printf("strongest bin     %.1f Hz, %.3f counts rms\n\n", peak * rate / n, sqrt(Power[peak]));
+}
+
+int main(int argc, char **argv){
+    static WireReader r;
+    FILE *in = stdin;
+    WireCapture h;
+    unsigned long bad = 0, captures = 0;
+    int c;
+
+    if(argc > 1 && (in = fopen(argv[1], "rb")) == NULL){
+        fprintf(stderr, "capture: can't read %s\n", argv[1]);
+        return 1;
+    }
+    wireInit(&r);
+    while((c = fgetc(in)) != EOF){
+        if(wireByte(&r, c) != WIRE_CAPTURE){
+            continue;
+        }
+        if(wireCapture(r.payload, r.length, &h) != 0){
+            bad++;
+            continue;
+        }
+        captures++;
+        report(r.payload, &h);
+    }
+    if(in != stdin){
+        fclose(in);
+    }
+    if(captures == 0){
+        printf("no capture in the line\n");
+    }
+    if(r.crcErrors + bad > 0){
+        fprintf(stderr, "capture: %lu CRC errors, %lu bad capture frames\n", r.crcErrors, bad);
+    }
+    return r.crcErrors + bad;
+}
@@ -0,0 +1,72 @@
+//--------------------------------------------------------------------
+// Pressure log to CSV
+//--------------------------------------------------------------------
+// Reads what the firmware sent on the UART, from a file or stdin, and
+// writes every record of every log dump ("e" on the terminal) as one
+// CSV line: seq, highest zone, peak in counts, samples at unsafe or
+// above and the RTC time the stretch started. Text and the other frames
+// are skipped. The exit code is the number of frames with a bad CRC or
+// a log payload that isn't whole records.
+//
+//     logcsv [line.bin] > log.csv
+//--------------------------------------------------------------------
+
+#include <stdio.h>
+#include "wire.h"
+
+static int bcd(unsigned char value){
+    return (value >> 4) * 10 + (value & 0x0F);
+}
+
+// 20yy-mm-dd hh:mm:ss, empty when the RTC wasn't read in time
+static void timeText(char *text, const unsigned char *t){
+    unsigned int n, set = 0;
+
+    for(n=0; n<7; n++){
+        set |= t[n];
+    }
+    if(!set){
+        text[0] = 0;
+        return;
+    }
+    sprintf(text, "20%02d-%02d-%02d %02d:%02d:%02d",
+            bcd(t[6]), bcd(t[5] & 0x1F), bcd(t[3] & 0x3F),
+            bcd(t[2] & 0x3F), bcd(t[1] & 0x7F), bcd(t[0] & 0x7F));
+}
+
+int main(int argc, char **argv){
+    static WireReader r;
+    FILE *in = stdin;
+    WireLog record;
+    char time[24];
+    unsigned long bad = 0;
+    unsigned int n;
+    int c;
+
+    if(argc > 1 && (in = fopen(argv[1], "rb")) == NULL){
+        fprintf(stderr, "logcsv: can't read %s\n", argv[1]);
+        return 1;
+    }
+    wireInit(&r);
+    printf("seq,zone,peak_counts,duration_samples,time\n");
+    while((c = fgetc(in)) != EOF){
+        if(wireByte(&r, c) != WIRE_LOG){
+            continue;
+        }
+        if(r.length % WIRE_LOG_BYTES != 0){
+            bad++;
+            continue;
+        }
+        for(n=0; wireLog(r.payload, r.length, n, &record) == 0; n++){
+            timeText(time, record.time);
+            printf("%u,%u,%u,%u,%s\n", record.seq, record.zone, record.peak, record.duration, time);
+        }
+    }
+    if(in != stdin){
+        fclose(in);
+    }
+    if(r.crcErrors + bad > 0){
+        fprintf(stderr, "logcsv: %lu CRC errors, %lu bad log frames\n", r.crcErrors, bad);
+    }
+    return r.crcErrors + bad;
+}
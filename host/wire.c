@@ -0,0 +1,172 @@
+//--------------------------------------------------------------------
+// Decoder for the frames FinalProject9main.c sends over the UART
+//--------------------------------------------------------------------
+// wireByte() takes the line one byte at a time and says whether the
+// byte was text, or ended a frame. A frame's payload stays in the
+// reader until the next byte, the wireStatus()/wireLog()/wireCapture()
+// decoders pick the fields out of it by offset, so nothing depends on
+// how this compiler lays out a struct.
+//--------------------------------------------------------------------
+
+#include "wire.h"
+
+static unsigned short Crc_Table[256];
+static int crcReady = 0;
+
+static void crcTable(void){
+    unsigned int n, b, crc;
+
+    for(n=0; n<256; n++){
+        crc = n << 8;
+        for(b=0; b<8; b++){
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+        Crc_Table[n] = crc & 0xFFFF;
+    }
+    crcReady = 1;
+}
+
+void wireInit(WireReader *r){
+    r->have = 0;
+    r->need = 0;
+    r->type = 0;
+    r->length = 0;
+    r->payload = &r->data[3];
+    r->frames = 0;
+    r->crcErrors = 0;
+    if(!crcReady){
+        crcTable();
+    }
+}
+
+// CRC16-CCITT seeded 0xFFFF, what the CRC module gives for bytes fed
+// through CRCDIRB_L
+unsigned int wireCrc(const unsigned char *data, unsigned long length){
+    unsigned int crc = 0xFFFF;
+    unsigned long n;
+
+    if(!crcReady){
+        crcTable();
+    }
+    for(n=0; n<length; n++){
+        crc = ((crc << 8) ^ Crc_Table[(crc >> 8) ^ data[n]]) & 0xFFFF;
+    }
+    return crc;
+}
+
+int wireByte(WireReader *r, unsigned char c){
+    unsigned int crc;
+
+    if(r->need == 0){
+        if(c != WIRE_SYNC){
+            return WIRE_TEXT;
+        }
+        r->have = 0;
+        r->need = 3;                      // type and length first
+        return WIRE_MORE;
+    }
+    r->data[r->have++] = c;
+    if(r->have == 3){
+        r->need = 3 + wireWord(&r->data[1]) + 2;
+    }
+    if(r->have < r->need){
+        return WIRE_MORE;
+    }
+
+    r->need = 0;
+    r->type = r->data[0];
+    r->length = wireWord(&r->data[1]);
+    crc = wireWord(&r->data[3 + r->length]);
+    if(crc != wireCrc(r->data, 3 + r->length)){
+        r->crcErrors++;
+        return WIRE_BAD;
+    }
+    r->frames++;
+    return r->type;
+}
+
+unsigned int wireWord(const unsigned char *at){
+    return at[0] | ((unsigned int)at[1] << 8);
+}
+
+long wireLong(const unsigned char *at){
+    unsigned long value = wireWord(at) | ((unsigned long)wireWord(&at[2]) << 16);
+
+    // sign extend from 32 bits whatever the size of long
+    return (value & 0x80000000UL) ? -(long)(0xFFFFFFFFUL - value) - 1 : (long)value;
+}
+
+int wireStatus(const unsigned char *payload, unsigned int length, WireStatus *s){
+    unsigned int n;
+
+    if(length != WIRE_STATUS_BYTES){
+        return -1;
+    }
+    s->force = wireWord(&payload[0]);
+    s->counts = wireWord(&payload[2]);
+    s->zone = payload[4];
+    s->dir = payload[5];
+    s->position = wireLong(&payload[6]);
+    s->stepsLeft = wireWord(&payload[10]);
+    for(n=0; n<7; n++){
+        s->time[n] = payload[12+n];
+    }
+    s->queued = payload[19];
+    return 0;
+}
+
+unsigned int wireLogCount(unsigned int length){
+    return length / WIRE_LOG_BYTES;
+}
+
+int wireLog(const unsigned char *payload, unsigned int length, unsigned int n, WireLog *r){
+    const unsigned char *at = &payload[n * WIRE_LOG_BYTES];
+    unsigned int k;
+
+    if(length % WIRE_LOG_BYTES != 0 || n >= wireLogCount(length)){
+        return -1;
+    }
+    for(k=0; k<7; k++){
+        r->time[k] = at[k];
+    }
+    r->zone = at[7];
+    r->peak = wireWord(&at[8]);
+    r->duration = wireWord(&at[10]);
+    r->seq = wireWord(&at[12]);
+    return 0;
+}
+
+int wireCapture(const unsigned char *payload, unsigned int length, WireCapture *h){
+    if(length < WIRE_CAP_HEAD_BYTES){
+        return -1;
+    }
+    h->count = wireWord(&payload[0]);
+    h->pre = wireWord(&payload[2]);
+    h->period = wireWord(&payload[4]);
+    h->level = wireWord(&payload[6]);
+    if(length != WIRE_CAP_HEAD_BYTES + 2UL*h->count || h->pre > h->count){
+        return -1;
+    }
+    return 0;
+}
+
+unsigned int wireSample(const unsigned char *payload, unsigned int n){
+    return wireWord(&payload[WIRE_CAP_HEAD_BYTES + 2*n]);
+}
+
+unsigned long wireBuild(unsigned char *out, unsigned int type,
+                        const unsigned char *payload, unsigned int length){
+    unsigned int n, crc;
+
+    out[0] = WIRE_SYNC;
+    out[1] = type;
+    out[2] = length & 0xFF;
+    out[3] = length >> 8;
+    for(n=0; n<length; n++){
+        out[4+n] = payload[n];
+    }
+    crc = wireCrc(&out[1], 3 + length);
+    out[4+length] = crc & 0xFF;
+    out[5+length] = crc >> 8;
+    return 6UL + length;
+}
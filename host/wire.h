@@ -0,0 +1,82 @@
+//--------------------------------------------------------------------
+// Decoder for the frames FinalProject9main.c sends over the UART
+//--------------------------------------------------------------------
+// A frame is FRAME_SYNC, type, payload length (u16), payload, CRC (u16),
+// every field little endian. The CRC is CRC16-CCITT seeded 0xFFFF over
+// type, length and payload. Anything between frames is terminal text.
+// The payload layouts are in the Frame Variables comment of the
+// firmware, the WIRE_*_BYTES sizes and the decoders here follow it.
+//--------------------------------------------------------------------
+
+#ifndef WIRE_H
+#define WIRE_H
+
+#define WIRE_SYNC 0xA5
+#define WIRE_STATUS 1
+#define WIRE_LOG 2
+#define WIRE_CAPTURE 3
+#define WIRE_STATUS_BYTES 20
+#define WIRE_LOG_BYTES 16                 // one record
+#define WIRE_CAP_HEAD_BYTES 8
+#define WIRE_MAX 65535                    // longest payload the length field holds
+
+// wireByte() results
+#define WIRE_TEXT (-1)                    // the byte is terminal text
+#define WIRE_BAD (-2)                     // a frame ended with the wrong CRC
+#define WIRE_MORE 0                       // inside a frame
+
+typedef struct {
+    unsigned char data[3 + WIRE_MAX + 2]; // type, length, payload, CRC
+    unsigned long have;                   // bytes after WIRE_SYNC
+    unsigned long need;                   // 0 while it's text
+    unsigned int type;                    // of the last complete frame
+    unsigned int length;
+    const unsigned char *payload;
+    unsigned long frames;                 // good frames
+    unsigned long crcErrors;
+} WireReader;
+
+typedef struct {
+    unsigned int force;                   // Q8 lb
+    unsigned int counts;                  // filtered reading
+    unsigned int zone;
+    unsigned int dir;                     // 0 forward, 1 reverse, 3 stopped
+    long position;                        // half steps
+    unsigned int stepsLeft;
+    unsigned char time[7];                // RTC seconds to year in BCD
+    unsigned int queued;
+} WireStatus;
+
+typedef struct {
+    unsigned char time[7];                // RTC seconds to year in BCD
+    unsigned int zone;                    // highest zone reached
+    unsigned int peak;                    // highest filtered reading, counts
+    unsigned int duration;                // samples at unsafe or above
+    unsigned int seq;
+} WireLog;
+
+typedef struct {
+    unsigned int count;                   // samples after the header
+    unsigned int pre;                     // samples before the trigger
+    unsigned int period;                  // us between samples
+    unsigned int level;                   // trigger level, counts
+} WireCapture;
+
+void wireInit(WireReader *r);
+int wireByte(WireReader *r, unsigned char c);     // WIRE_TEXT, WIRE_BAD, WIRE_MORE or the type
+unsigned int wireCrc(const unsigned char *data, unsigned long length);
+unsigned int wireWord(const unsigned char *at);
+long wireLong(const unsigned char *at);
+
+// 0 when the payload has the layout of its type, -1 when it doesn't
+int wireStatus(const unsigned char *payload, unsigned int length, WireStatus *s);
+int wireLog(const unsigned char *payload, unsigned int length, unsigned int n, WireLog *r);
+unsigned int wireLogCount(unsigned int length);
+int wireCapture(const unsigned char *payload, unsigned int length, WireCapture *h);
+unsigned int wireSample(const unsigned char *payload, unsigned int n);
+
+// a whole frame around payload into out, returns its length
+unsigned long wireBuild(unsigned char *out, unsigned int type,
+                        const unsigned char *payload, unsigned int length);
+
+#endif
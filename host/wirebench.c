@@ -0,0 +1,179 @@
+//--------------------------------------------------------------------
+// Decode rate of wire.c
+//--------------------------------------------------------------------
+// Builds a line the way the firmware fills it, status frames with
+// terminal text between them and now and then a full log dump and a
+// capture, then decodes it over and over for about a second. Every
+// frame has to come back with its fields, the exit code is the number
+// of failed checks. Reports frames (msgs) a second against what
+// 115200 baud can carry.
+//--------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "wire.h"
+
+#define BAUD 115200
+#define LINE_BYTES (BAUD / 10)            // 8N1
+#define STATUS_FRAMES 100000
+#define LOG_EVERY 1000                    // status frames between log dumps
+#define CAPTURE_EVERY 10000
+#define LOG_RECORDS 64
+#define CAP_SIZE 2048
+
+static const char Text[] = "\n\r Motor moved forward 36 degrees. \n\r";
+
+static unsigned char *Line;
+static unsigned long lineLen = 0;
+static int failures = 0;
+
+static void check(int ok, const char *what){
+    if(!ok){
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static unsigned char *putWord(unsigned char *at, unsigned int value){
+    at[0] = value & 0xFF;
+    at[1] = (value >> 8) & 0xFF;
+    return at + 2;
+}
+
+static void status(unsigned long n){
+    unsigned char payload[WIRE_STATUS_BYTES] = {0};
+    unsigned char *at = payload;
+    long position = (long)(n % 4000) - 2000;
+
+    at = putWord(at, n & 0xFFFF);
+    at = putWord(at, n % 4096);
+    *at++ = n % 4;
+    *at++ = 3;
+    at = putWord(at, (unsigned long)position & 0xFFFF);
+    putWord(at, ((unsigned long)position >> 16) & 0xFFFF);
+    lineLen += wireBuild(&Line[lineLen], WIRE_STATUS, payload, sizeof(payload));
+}
+
+static void logDump(void){
+    static unsigned char payload[LOG_RECORDS * WIRE_LOG_BYTES];
+    unsigned int n;
+
+    for(n=0; n<LOG_RECORDS; n++){
+        payload[n*WIRE_LOG_BYTES + 7] = 3;
+        putWord(&payload[n*WIRE_LOG_BYTES + 12], n);
+    }
+    lineLen += wireBuild(&Line[lineLen], WIRE_LOG, payload, sizeof(payload));
+}
+
+static void capture(void){
+    static unsigned char payload[WIRE_CAP_HEAD_BYTES + 2*CAP_SIZE];
+    unsigned char *at = payload;
+    unsigned int n;
+
+    at = putWord(at, CAP_SIZE);
+    at = putWord(at, 512);
+    at = putWord(at, 1000);
+    at = putWord(at, 2048);
+    for(n=0; n<CAP_SIZE; n++){
+        at = putWord(at, n*2);
+    }
+    lineLen += wireBuild(&Line[lineLen], WIRE_CAPTURE, payload, sizeof(payload));
+}
+
+static double seconds(void){
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(void){
+    static WireReader r;
+    unsigned long n, frames = 0, text = 0, bad = 0, passes = 0, i;
+    unsigned long expected = 0, statusNext = 0;
+    WireStatus s;
+    WireCapture h;
+    double start, took;
+    int type;
+
+    Line = malloc((unsigned long)STATUS_FRAMES * 80);
+    if(Line == NULL){
+        return 1;
+    }
+    for(n=0; n<STATUS_FRAMES; n++){
+        status(n);
+        if(n % 10 == 0){
+            for(i=0; i<sizeof(Text)-1; i++){
+                Line[lineLen++] = Text[i];
+            }
+        }
+        if(n % LOG_EVERY == LOG_EVERY-1){
+            logDump();
+            expected++;
+        }
+        if(n % CAPTURE_EVERY == CAPTURE_EVERY-1){
+            capture();
+            expected++;
+        }
+    }
+    expected += STATUS_FRAMES;
+
+    // one pass that looks at every field
+    wireInit(&r);
+    for(i=0; i<lineLen; i++){
+        type = wireByte(&r, Line[i]);
+        if(type == WIRE_TEXT){
+            text++;
+        }else if(type == WIRE_STATUS){
+            if(wireStatus(r.payload, r.length, &s) != 0 || s.force != (statusNext & 0xFFFF) ||
+               s.position != (long)(statusNext % 4000) - 2000){
+                bad++;
+            }
+            statusNext++;
+        }else if(type == WIRE_LOG){
+            if(wireLogCount(r.length) != LOG_RECORDS){
+                bad++;
+            }
+        }else if(type == WIRE_CAPTURE){
+            if(wireCapture(r.payload, r.length, &h) != 0 || wireSample(r.payload, CAP_SIZE-1) != 2*(CAP_SIZE-1)){
+                bad++;
+            }
+        }
+    }
+    check(r.frames == expected, "frames lost");
+    check(r.crcErrors == 0, "CRC errors on a clean line");
+    check(bad == 0, "fields decoded wrong");
+
+    // a flipped bit has to show up as a CRC error, not a frame
+    Line[4] ^= 0x01;
+    wireInit(&r);
+    for(i=0; i<lineLen; i++){
+        wireByte(&r, Line[i]);
+    }
+    Line[4] ^= 0x01;
+    check(r.crcErrors == 1 && r.frames == expected-1, "flipped bit not caught");
+
+    // rate
+    start = seconds();
+    do{
+        wireInit(&r);
+        for(i=0; i<lineLen; i++){
+            if(wireByte(&r, Line[i]) > 0){
+                frames++;
+            }
+        }
+        passes++;
+        took = seconds() - start;
+    }while(took < 1.0);
+
+    printf("line              %lu bytes, %lu frames, %lu text bytes\n", lineLen, expected, text);
+    printf("decode            %.0f msgs/s, %.1f MB/s (%lu passes in %.2f s)\n",
+           frames / took, passes * lineLen / took / 1e6, passes, took);
+    printf("115200 baud       %.0f status msgs/s at most, decoder keeps up %.0f times over\n",
+           (double)LINE_BYTES / (6 + WIRE_STATUS_BYTES),
+           passes * lineLen / took / LINE_BYTES);
+    printf("%s, %d failed\n", failures ? "FAIL" : "PASS", failures);
+    free(Line);
+    return failures;
+}
@@ -0,0 +1,31 @@
+//--------------------------------------------------------------------
+// Scenario hooks for the tools that link the firmware but never call
+// simRun(), the model only gives them the registers
+//--------------------------------------------------------------------
+
+#include "sim.h"
+
+unsigned int scenarioAnalog(unsigned long long at){
+    (void)at;
+    return 0;
+}
+
+unsigned long long scenarioNext(void){
+    return NEVER;
+}
+
+void scenarioStep(void){
+}
+
+void scenarioUartTx(unsigned char c){
+    (void)c;
+}
+
+void scenarioIsr(int source, unsigned long long entry, int done){
+    (void)source;
+    (void)entry;
+    (void)done;
+}
+
+void scenarioMain(void){
+}
@@ -0,0 +1,86 @@
+//--------------------------------------------------------------------
+// Clock dividers of FinalProject9main.c at each MCLK_MHZ
+//--------------------------------------------------------------------
+// Built once for each MCLK_MHZ, with the firmware built the same way.
+// Runs init() on the FR2355 model and reads back what the registers give
+// from the clock the FLL really makes, 32768 * (FLLN+1), which for 8, 16
+// and 24 MHz is 576 ppm under. Checks against the settings:
+//   MCLK      within CLOCK_PPM of MCLK_MHZ, with the FRAM wait states the
+//             part needs at that speed
+//   TB1 TB3   TIMER_HZ within CLOCK_PPM, TB1 triggering at SAMPLE_HZ
+//   TB2       MCLK undivided, the profiler counts cycles
+//   UART      BAUD within BAUD_ERROR over a frame
+//   I2C       at most I2C_HZ and within I2C_ERROR under it
+//   ADC       SMCLK, 5 MHz or less
+// The exit code is the number of failed checks.
+//
+//     make clocks
+//--------------------------------------------------------------------
+
+#include <stdio.h>
+#include "msp430.h"
+#include "sim.h"
+
+#define RUN_TIME 0.05
+#define TIMER_HZ 1000000UL                // as in the firmware
+#define SAMPLE_HZ 1000
+#define BAUD 115200
+#define I2C_HZ 400000UL
+#define CLOCK_PPM 1000                    // the FLL is 576 ppm under at all three
+#define BAUD_ERROR 1.0                    // %, the far end samples mid bit
+#define I2C_ERROR 5.0                     // %
+#define ADC_MAX 5000000UL
+
+int fw_main(void);
+
+static int failures = 0;
+
+static void check(int ok, const char *what){
+    if(!ok){
+        printf("FAIL: %s at %d MHz\n", what, MCLK_MHZ);
+        failures++;
+    }
+}
+
+static double ppm(double actual, double wanted){
+    return (actual / wanted - 1) * 1e6;
+}
+
+int main(void){
+    static const unsigned int Pdiv[4] = {1, 4, 64, 64};
+    unsigned long mclk, adc;
+    unsigned int waits, needed;
+    double timer, sample, baud, i2c;
+
+    if(simRun(fw_main, RUN_TIME) != 0){
+        printf("FAIL: main() returned\n");
+        return 1;
+    }
+    mclk = simMclkHz();
+    waits = (FRCTL0 >> 4) & 7;          // NWAITS
+    needed = (MCLK_MHZ > 16) ? 2 : (MCLK_MHZ > 8) ? 1 : 0;
+    timer = (double)mclk / simTimerDiv(3);
+    sample = simAdcInterval.count ? (double)simMclkHz() * simAdcInterval.count / simAdcInterval.sum : 0;
+    baud = simUartBaud();
+    i2c = simI2cHz();
+    adc = mclk / (((ADCCTL1 & ADCDIV) >> 5) + 1) / Pdiv[(ADCCTL2 & ADCPDIV) >> 8];
+
+    printf("%2d MHz   MCLK %lu Hz %+.0f ppm, FLLN %u, NWAITS %u\n", MCLK_MHZ, mclk,
+           ppm(mclk, MCLK_MHZ * 1e6), CSCTL2 & FLLN, waits);
+    printf("         TB3 %.1f Hz %+.0f ppm, TB1 %.1f Hz %+.0f ppm, sampling %.3f Hz %+.0f ppm\n",
+           timer, ppm(timer, TIMER_HZ), (double)mclk / simTimerDiv(1),
+           ppm((double)mclk / simTimerDiv(1), TIMER_HZ), sample, ppm(sample, SAMPLE_HZ));
+    printf("         TB2 /%u, UART %.0f baud %+.3f%%, I2C %.0f Hz %+.3f%%, ADC %lu Hz\n",
+           simTimerDiv(2), baud, 100 * (baud / BAUD - 1), i2c, 100 * (i2c / I2C_HZ - 1), adc);
+
+    check(ppm(mclk, MCLK_MHZ * 1e6) < CLOCK_PPM && ppm(mclk, MCLK_MHZ * 1e6) > -CLOCK_PPM, "MCLK off");
+    check(waits >= needed, "too few FRAM wait states");
+    check(ppm(timer, TIMER_HZ) < CLOCK_PPM && ppm(timer, TIMER_HZ) > -CLOCK_PPM, "TB3 not at TIMER_HZ");
+    check(simTimerDiv(1) == simTimerDiv(3), "TB1 and TB3 divided differently");
+    check(ppm(sample, SAMPLE_HZ) < CLOCK_PPM && ppm(sample, SAMPLE_HZ) > -CLOCK_PPM, "not sampling at SAMPLE_HZ");
+    check(simTimerDiv(2) == 1, "TB2 divided, the profiler isn't counting cycles");
+    check(100 * (baud / BAUD - 1) < BAUD_ERROR && 100 * (baud / BAUD - 1) > -BAUD_ERROR, "baud off");
+    check(i2c <= I2C_HZ && 100 * (1 - i2c / I2C_HZ) < I2C_ERROR, "I2C clock off");
+    check((ADCCTL1 & ADCSSEL) == ADCSSEL_2 && adc <= ADC_MAX, "ADC clock over 5 MHz");
+    return failures;
+}
@@ -0,0 +1,162 @@
+//--------------------------------------------------------------------
+// postEvent() against getEvent() with the producer interrupting
+//--------------------------------------------------------------------
+// On the MSP430 an ISR can land between any two instructions of main().
+// Here a POSIX timer signal plays the ISR: its handler calls the
+// firmware's postEvent() on the same thread, so it cuts into getEvent()
+// wherever the consumer loop happens to be, the way an interrupt would.
+// Each event carries a sequence number in data and its complement in
+// type, so the consumer can tell:
+//   ordering  every event comes out once, in the order it went in
+//   payload   type and data from the same post
+//   drops     what's missing from the sequence is exactly evDropped
+// over three runs: the consumer keeping up, stalling for a few ms now and
+// then so the queue fills, and taking longer over each event than the
+// signal period so the queue stays full and every getEvent() runs against
+// posts to a full queue.
+// The exit code is the number of failed checks.
+//
+//     make events
+//--------------------------------------------------------------------
+
+#include <stdio.h>
+#include <signal.h>
+#include <time.h>
+
+#define EV_SIZE 16
+#define RUN_TIME 2.0                      // seconds of each phase
+#define SIGNAL_NS 20000                   // signal period asked for
+#define STALL_EVERY 2000                  // events between consumer stalls
+#define STALL_TIME 0.002
+#define SLOW_TIME 30e-6                   // consumer time per event, over SIGNAL_NS
+
+// firmware state
+typedef struct {
+    unsigned int type;
+    unsigned int data;
+} Event;
+extern volatile unsigned int evHead;
+extern volatile unsigned int evTail;
+extern volatile unsigned int evDropped;
+int postEvent(unsigned int type, unsigned int data);
+int getEvent(Event *ev);
+
+static volatile unsigned long posted = 0; // attempts, the handler's sequence number
+static int failures = 0;
+static sigset_t Alarm;
+
+static void check(int ok, const char *what){
+    if(!ok){
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static void isr(int sig){
+    unsigned int seq = posted & 0xFFFF;
+
+    (void)sig;
+    postEvent(~seq & 0xFFFF, seq);
+    posted++;
+}
+
+static double seconds(void){
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// drains the queue for RUN_TIME, stalling every STALL_EVERY events and
+// spending work seconds on each. Starts and ends with the signal blocked
+// and the queue empty.
+static void phase(const char *name, int stall, double work){
+    unsigned long got = 0, torn = 0, order = 0, stalls = 0, dropped, missing = 0;
+    unsigned int expect = posted & 0xFFFF, depth, deepest = 0, lost = evDropped;
+    double end = seconds() + RUN_TIME, until;
+    Event ev;
+
+    sigprocmask(SIG_UNBLOCK, &Alarm, NULL);
+    while(seconds() < end){
+        depth = (evHead - evTail) & (EV_SIZE-1);
+        deepest = (depth > deepest) ? depth : deepest;
+        if(getEvent(&ev) != 0){
+            continue;
+        }
+        got++;
+        if(ev.type != (~ev.data & 0xFFFF)){
+            torn++;
+        }
+        if(ev.data != expect){
+            // a gap is dropped events, anything else is out of order
+            if(((ev.data - expect) & 0xFFFF) > 0x8000){
+                order++;
+            }else{
+                missing += (ev.data - expect) & 0xFFFF;
+            }
+        }
+        expect = (ev.data + 1) & 0xFFFF;
+        until = seconds() + work;
+        if(stall && got % STALL_EVERY == 0){
+            stalls++;
+            until += STALL_TIME;
+        }
+        while(seconds() < until);
+    }
+
+    // the last ones out
+    sigprocmask(SIG_BLOCK, &Alarm, NULL);
+    while(getEvent(&ev) == 0){
+        got++;
+        missing += (ev.data - expect) & 0xFFFF;
+        expect = (ev.data + 1) & 0xFFFF;
+    }
+    missing += (posted - expect) & 0xFFFF;
+    dropped = (evDropped - lost) & 0xFFFF;
+
+    printf("%-10s %lu events out, %lu dropped, %lu missing, deepest %u of %d, %lu stalls\n",
+           name, got, dropped, missing, deepest, EV_SIZE-1, stalls);
+    check(torn == 0, "event payload torn");
+    check(order == 0, "events out of order or repeated");
+    check(missing == dropped, "events missing that evDropped didn't count");
+    check((!stall && work == 0) || dropped > 0, "the queue never filled");
+}
+
+int main(void){
+    struct sigaction action;
+    struct sigevent event;
+    struct itimerspec period;
+    timer_t timer;
+    unsigned long before;
+
+    action.sa_handler = isr;
+    action.sa_flags = 0;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGALRM, &action, NULL);
+    sigemptyset(&Alarm);
+    sigaddset(&Alarm, SIGALRM);
+    sigprocmask(SIG_BLOCK, &Alarm, NULL);
+
+    event.sigev_notify = SIGEV_SIGNAL;
+    event.sigev_signo = SIGALRM;
+    if(timer_create(CLOCK_MONOTONIC, &event, &timer) != 0){
+        printf("FAIL: no timer\n");
+        return 1;
+    }
+    period.it_value.tv_sec = 0;
+    period.it_value.tv_nsec = SIGNAL_NS;
+    period.it_interval = period.it_value;
+    timer_settime(timer, 0, &period, NULL);
+
+    before = posted;
+    phase("keeping up", 0, 0);
+    phase("stalling", 1, 0);
+    phase("slow", 0, SLOW_TIME);
+    timer_delete(timer);
+
+    printf("%lu posts in %.0f s, one every %.1f us\n", posted - before, 3*RUN_TIME,
+           3*RUN_TIME * 1e6 / (posted - before));
+    check(posted - before > 10000, "too few signals to mean anything");
+    printf("%s, %d failed\n", failures ? "FAIL" : "PASS", failures);
+    return failures;
+}
@@ -0,0 +1,289 @@
+//--------------------------------------------------------------------
+// Filter chains of FinalProject9main.c on pressure traces
+//--------------------------------------------------------------------
+// Runs the firmware's own adcFilter() over traces for each of a set of
+// Filter_Chain settings, a block of ADC_BLOCK samples at a time the way
+// ADC_ISR hands them over, and looks at AVE_Value after each block as
+// adcStatus() would. Reports:
+//   latency   a step from 45 to 55 lb, ms from the step to the first
+//             block at or over the cutoff level, for every position of
+//             the step in the block and several noise seeds
+//   noise     variance of the output at a steady 40 lb, counts^2
+//   spikes    blocks over the cutoff at 45 lb with a one sample 60 lb
+//             spike every 64 samples
+// The noise is +-NOISE counts like the drillsim scenario. With a file of
+// counts, one sample a ms, whitespace between them, the trace is run
+// through every chain as well: latency to the first block over the level
+// against the raw trace, and the variance of the output around a straight
+// line over the first half of the samples before the raw trace got there.
+// The exit code is 1 when the file can't be read.
+//
+//     filters [counts.txt [level]]
+//--------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FILTER_NONE 0
+#define FILTER_AVERAGE 1
+#define FILTER_MEDIAN 2
+#define FILTER_EMA 3
+#define FILTER_IIR1 4
+#define FILTER_IIR2 5
+#define FILTER_STAGES 3
+#define ADC_BLOCK 8
+#define ADC_SHIFT 4                       // as in the firmware
+#define ADC_WINDOW (1 << ADC_SHIFT)
+#define MEDIAN_SIZE 5
+#define ZONE_CUTOFF 3
+#define COUNTS_PER_LB 51.2                // default calibration, 2560 counts at 50 lb
+#define NOISE 3
+#define SEEDS 16
+#define WARM 256                          // samples before the step or the statistics
+#define TRACE_MAX 1000000
+
+// firmware state
+extern int Filter_Chain[FILTER_STAGES];
+extern unsigned int ADC_Block[][ADC_BLOCK];
+extern unsigned int AVE_Value;
+extern unsigned int Zone_Enter[];
+extern unsigned long int total;
+extern unsigned int index;
+extern unsigned int width;
+extern unsigned int ADC_Values[];
+extern unsigned int medianIndex;
+extern unsigned int medianWidth;
+extern int emaPrimed;
+extern int iir1Primed;
+extern int iir2Primed;
+int adcFilter(unsigned int block);
+int calInit(void);
+
+typedef struct {
+    const char *name;
+    int chain[FILTER_STAGES];
+} Chain;
+
+static const Chain Chains[] = {
+    {"none",             {FILTER_NONE, FILTER_NONE, FILTER_NONE}},
+    {"average",          {FILTER_AVERAGE, FILTER_NONE, FILTER_NONE}},
+    {"median",           {FILTER_MEDIAN, FILTER_NONE, FILTER_NONE}},
+    {"ema",              {FILTER_EMA, FILTER_NONE, FILTER_NONE}},
+    {"iir1",             {FILTER_IIR1, FILTER_NONE, FILTER_NONE}},
+    {"iir2",             {FILTER_IIR2, FILTER_NONE, FILTER_NONE}},
+    {"median+average",   {FILTER_MEDIAN, FILTER_AVERAGE, FILTER_NONE}},
+    {"median+ema",       {FILTER_MEDIAN, FILTER_EMA, FILTER_NONE}},
+    {"median+iir2",      {FILTER_MEDIAN, FILTER_IIR2, FILTER_NONE}},
+};
+#define CHAINS (sizeof(Chains) / sizeof(Chains[0]))
+#define CHAIN_NONE 0
+#define CHAIN_AVERAGE 1
+#define CHAIN_DEFAULT 7                   // what Filter_Chain starts as
+
+static unsigned int Trace[TRACE_MAX];
+static unsigned int Output[TRACE_MAX / ADC_BLOCK];
+static unsigned long seed;
+static double Latency[CHAINS];            // mean, ms
+static double Variance[CHAINS];
+
+static int noise(void){
+    seed = seed * 1103515245UL + 12345;
+    return (int)((seed >> 16) % (2*NOISE+1)) - NOISE;
+}
+
+static unsigned int counts(double lb){
+    return (unsigned int)(lb * COUNTS_PER_LB + noise());
+}
+
+// as after reset, with chain c
+static void filterReset(const Chain *c){
+    unsigned int n;
+
+    for(n=0; n<FILTER_STAGES; n++){
+        Filter_Chain[n] = c->chain[n];
+    }
+    for(n=0; n<ADC_WINDOW; n++){
+        ADC_Values[n] = 0;
+    }
+    total = 0;
+    index = 0;
+    width = 0;
+    medianIndex = 0;
+    medianWidth = 0;
+    emaPrimed = 0;
+    iir1Primed = 0;
+    iir2Primed = 0;
+}
+
+// every whole block of Trace, Output gets AVE_Value after each
+static unsigned long replay(const Chain *c, unsigned long length){
+    unsigned long block, n;
+
+    filterReset(c);
+    for(block=0; block<length/ADC_BLOCK; block++){
+        for(n=0; n<ADC_BLOCK; n++){
+            ADC_Block[0][n] = Trace[block*ADC_BLOCK + n];
+        }
+        adcFilter(0);
+        Output[block] = AVE_Value;
+    }
+    return length / ADC_BLOCK;
+}
+
+// index of the first value at or over level, -1 if none
+static long firstOver(const unsigned int *values, unsigned long count, unsigned int level){
+    unsigned long n;
+
+    for(n=0; n<count; n++){
+        if(values[n] >= level){
+            return n;
+        }
+    }
+    return -1;
+}
+
+// variance of values[from..to) around a least squares line
+static double detrended(const unsigned int *values, unsigned long from, unsigned long to){
+    double n = to - from, mx = 0, my = 0, sxx = 0, sxy = 0, slope, r, var = 0;
+    unsigned long i;
+
+    if(to < from + 3){
+        return 0;
+    }
+    for(i=from; i<to; i++){
+        mx += i;
+        my += values[i];
+    }
+    mx /= n;
+    my /= n;
+    for(i=from; i<to; i++){
+        sxx += (i - mx) * (i - mx);
+        sxy += (i - mx) * (values[i] - my);
+    }
+    slope = sxy / sxx;
+    for(i=from; i<to; i++){
+        r = values[i] - (my + slope * (i - mx));
+        var += r * r;
+    }
+    return var / (n - 2);
+}
+
+static void synthetic(unsigned int level){
+    unsigned long n, blocks, trials;
+    unsigned int c, phase, s, trips;
+    long first;
+    double sum, worst, var;
+
+    printf("synthetic traces, cutoff at %u counts, +-%d counts noise, %d sample blocks\n",
+           level, NOISE, ADC_BLOCK);
+    printf("chain              latency ms mean/max   noise counts^2   spike blocks\n");
+    for(c=0; c<CHAINS; c++){
+        // step, at every position in a block
+        sum = 0;
+        worst = 0;
+        trials = 0;
+        for(s=0; s<SEEDS; s++){
+            for(phase=0; phase<ADC_BLOCK; phase++){
+                seed = s + 1;
+                for(n=0; n<WARM+256; n++){
+                    Trace[n] = counts((n < WARM + phase) ? 45 : 55);
+                }
+                blocks = replay(&Chains[c], WARM+256);
+                first = firstOver(Output, blocks, level);
+                if(first >= 0){
+                    first = first*ADC_BLOCK + ADC_BLOCK-1 - (WARM + phase);
+                    sum += first;
+                    worst = (first > worst) ? first : worst;
+                    trials++;
+                }
+            }
+        }
+
+        // steady
+        seed = 99;
+        for(n=0; n<WARM+8192; n++){
+            Trace[n] = counts(40);
+        }
+        blocks = replay(&Chains[c], WARM+8192);
+        var = detrended(Output, WARM/ADC_BLOCK, blocks);
+
+        // spikes
+        seed = 7;
+        for(n=0; n<WARM+8192; n++){
+            Trace[n] = (n % 64 == 63) ? counts(60) : counts(45);
+        }
+        blocks = replay(&Chains[c], WARM+8192);
+        trips = 0;
+        for(n=WARM/ADC_BLOCK; n<blocks; n++){
+            trips += Output[n] >= level;
+        }
+
+        Latency[c] = trials ? sum / trials : -1;
+        Variance[c] = var;
+        if(trials == SEEDS*ADC_BLOCK){
+            printf("%-18s %7.2f %6.0f       %10.2f       %8u\n", Chains[c].name,
+                   sum / trials, worst, var, trips);
+        }else{
+            printf("%-18s   never             %10.2f       %8u\n", Chains[c].name, var, trips);
+        }
+    }
+
+    // the default chain against the 16 sample average it replaced, the
+    // block wait ("none") taken off both
+    printf("median+ema        %.2f ms of filter delay against %.2f for the average (%.0f%%), %.2f times the variance\n",
+           Latency[CHAIN_DEFAULT] - Latency[CHAIN_NONE], Latency[CHAIN_AVERAGE] - Latency[CHAIN_NONE],
+           100 * (Latency[CHAIN_DEFAULT] - Latency[CHAIN_NONE]) / (Latency[CHAIN_AVERAGE] - Latency[CHAIN_NONE]), Variance[CHAIN_DEFAULT] / Variance[CHAIN_AVERAGE]);
+}
+
+static int recorded(const char *path, unsigned int level){
+    FILE *in = fopen(path, "r");
+    unsigned long length = 0, blocks;
+    unsigned int c, value;
+    long raw, first;
+
+    if(in == NULL){
+        fprintf(stderr, "filters: can't read %s\n", path);
+        return 1;
+    }
+    while(length < TRACE_MAX && fscanf(in, "%u", &value) == 1){
+        Trace[length++] = value;
+    }
+    fclose(in);
+    raw = firstOver(Trace, length, level);
+
+    printf("\n%s, %lu samples, level %u counts", path, length, level);
+    if(raw < 0){
+        printf(", never reached\n");
+    }else{
+        printf(", reached at sample %ld\n", raw);
+    }
+    printf("chain              latency ms   noise counts^2\n");
+    for(c=0; c<CHAINS; c++){
+        blocks = replay(&Chains[c], length);
+        first = firstOver(Output, blocks, level);
+        printf("%-18s ", Chains[c].name);
+        if(first < 0 || raw < 0){
+            printf("  never  ");
+        }else{
+            printf("%7ld  ", first*ADC_BLOCK + ADC_BLOCK-1 - raw);
+        }
+        printf("   %10.2f\n", detrended(Output, WARM/ADC_BLOCK,
+                                       (raw < 0 ? length : (unsigned long)raw) / 2 / ADC_BLOCK));
+    }
+    return 0;
+}
+
+int main(int argc, char **argv){
+    unsigned int level;
+
+    calInit();
+    level = Zone_Enter[ZONE_CUTOFF];
+    if(argc > 2){
+        level = atoi(argv[2]);
+    }
+    synthetic(level);
+    if(argc > 1){
+        return recorded(argv[1], level);
+    }
+    return 0;
+}
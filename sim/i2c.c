@@ -0,0 +1,185 @@
+//--------------------------------------------------------------------
+// I2C transfers of FinalProject9main.c at each bus speed
+//--------------------------------------------------------------------
+// Built once for each I2C_HZ, with the firmware built the same way.
+// Runs the firmware on the FR2355 model and, from main(), starts each
+// kind of transfer i2cTransfer() does with the RTC REPEAT times, whenever
+// the bus is free of the firmware's own status reads. A transfer takes
+// from the call to EUSCI_B1_I2C_ISR leaving the bus idle, so the ISRs and
+// the single byte STOP deadline count too. Each kind is shown next to the
+// bit times it can't be faster than, START, address and 9 bits a byte,
+// a repeated start and address when it reads after writing, and STOP.
+// Given the path of a build at another speed, ./i2c-100000 to
+// ./i2c-400000, it runs that one with -q and shows how many times faster
+// this speed is.
+// The exit code is the number of failed checks.
+//
+//     i2c [-q | other build]           -q prints the mean us, one a line
+//--------------------------------------------------------------------
+
+#define _POSIX_C_SOURCE 2                 // popen
+#include <stdio.h>
+#include <string.h>
+#include "msp430.h"
+#include "sim.h"
+
+#define RUN_TIME 2.0
+#define REPEAT 20
+#define RTC_ADDR 0x68
+#define RTC_TIME_REG 0x03
+#define I2C_NO_EVENT 0xFFFF
+
+typedef struct {
+    const char *name;
+    unsigned int txLen;
+    unsigned int rxLen;
+} Kind;
+
+static const Kind Kinds[] = {
+    {"set the time", 8, 0},               // register then 7 time bytes, as at start up
+    {"read the time", 1, 7},              // rtcRead()
+    {"read a register", 1, 1},            // single byte read, the STOP deadline
+    {"read all 20", 1, 20},
+    {"read on", 0, 7},                    // from where the last one left off
+};
+#define KINDS (sizeof(Kinds) / sizeof(Kinds[0]))
+
+// firmware state
+extern volatile int i2cState;
+extern volatile unsigned int i2cErrors;
+int fw_main(void);
+int i2cTransfer(unsigned int addr, const char *tx, unsigned int txLen,
+                char *rx, unsigned int rxLen, unsigned int event);
+
+static const char Tx[8] = {RTC_TIME_REG, 0x00, 0x14, 0x12, 0x06, 0x03, 0x12, 0x24};
+static char Rx[20];
+static SimStat Took[KINDS];
+static unsigned int kind = 0;
+static unsigned int repeats = 0;          // of this kind
+static unsigned long long startedAt = 0;  // 0 while none of ours is on the bus
+static int failures = 0;
+
+static void check(int ok, const char *what){
+    if(!ok){
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// bus time a kind can't beat, us
+static double floorUs(const Kind *k){
+    unsigned int bits = 2;                // START and STOP
+
+    if(k->txLen > 0){
+        bits += 9 * (1 + k->txLen);
+    }
+    if(k->rxLen > 0){
+        bits += 9 * (1 + k->rxLen) + (k->txLen > 0);
+    }
+    return bits * 1e6 / simI2cHz();
+}
+
+//--------------- Scenario -------------------------------------------
+
+unsigned int scenarioAnalog(unsigned long long at){
+    (void)at;
+    return 256;                           // 5 lb, zone 0
+}
+
+unsigned long long scenarioNext(void){
+    return NEVER;
+}
+
+void scenarioStep(void){
+}
+
+void scenarioUartTx(unsigned char c){
+    (void)c;
+}
+
+// the next transfer once the bus is free, after the start up write
+void scenarioMain(void){
+    const Kind *k;
+
+    if(kind >= KINDS || startedAt != 0 || simUs(simNow) < 100000 || i2cState != 0){
+        return;
+    }
+    k = &Kinds[kind];
+    if(i2cTransfer(RTC_ADDR, Tx, k->txLen, Rx, k->rxLen, I2C_NO_EVENT) == 0){
+        startedAt = simNow;
+    }
+}
+
+void scenarioIsr(int source, unsigned long long entry, int done){
+    (void)entry;
+    if(source != SRC_B1 || !done || startedAt == 0 || i2cState != 0){
+        return;
+    }
+    statAdd(&Took[kind], simNow - startedAt);
+    startedAt = 0;
+    if(++repeats == REPEAT){
+        repeats = 0;
+        kind++;
+    }
+}
+
+//--------------- Report ---------------------------------------------
+
+static double meanUs(const SimStat *s){
+    return s->count ? simUs(s->sum) / s->count : 0;
+}
+
+// the other build's means, 0 where it had none
+static int other(const char *build, double *means){
+    char command[256];
+    unsigned int n = 0;
+    FILE *in;
+
+    snprintf(command, sizeof(command), "%s -q", build);
+    if((in = popen(command, "r")) == NULL){
+        return -1;
+    }
+    while(n < KINDS && fscanf(in, "%lf", &means[n]) == 1){
+        n++;
+    }
+    return (pclose(in) == 0 && n == KINDS) ? 0 : -1;
+}
+
+int main(int argc, char **argv){
+    double Other[KINDS];
+    unsigned int n;
+    int quiet = (argc > 1 && strcmp(argv[1], "-q") == 0);
+    int compare = (argc > 1 && !quiet && other(argv[1], Other) == 0);
+
+    if(simRun(fw_main, RUN_TIME) != 0){
+        printf("FAIL: main() returned\n");
+        return 1;
+    }
+    if(quiet){
+        for(n=0; n<KINDS; n++){
+            printf("%.3f\n", meanUs(&Took[n]));
+        }
+        return (kind == KINDS && i2cErrors == 0) ? 0 : 1;
+    }
+
+    printf("I2C at %.1f kHz, %lu transfers START to STOP %.1f..%.1f us, %u errors\n",
+           simI2cHz() / 1000, simI2cTime.count, simUs(simI2cTime.min), simUs(simI2cTime.max), i2cErrors);
+    printf("transfer          tx  rx   us mean    max   bits us%s\n", compare ? "   other us  faster" : "");
+    for(n=0; n<KINDS; n++){
+        printf("%-16s  %2u  %2u  %8.1f %6.1f   %7.1f", Kinds[n].name, Kinds[n].txLen, Kinds[n].rxLen,
+               meanUs(&Took[n]), simUs(Took[n].max), floorUs(&Kinds[n]));
+        if(compare){
+            printf("   %8.1f  %5.2fx", Other[n], Other[n] / meanUs(&Took[n]));
+        }
+        printf("\n");
+        check(Took[n].count == REPEAT, "a transfer never finished");
+        check(simUs(Took[n].min) >= floorUs(&Kinds[n]), "a transfer faster than the bus");
+    }
+    if(argc > 1 && !quiet && !compare){
+        printf("FAIL: no times from %s\n", argv[1]);
+        failures++;
+    }
+    check(i2cErrors == 0, "I2C errors");
+    printf("%s, %d failed\n", failures ? "FAIL" : "PASS", failures);
+    return failures;
+}
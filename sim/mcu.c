@@ -0,0 +1,1166 @@
+//--------------------------------------------------------------------
+// MSP430FR2355 model for the host build of FinalProject9main.c
+//--------------------------------------------------------------------
+// A virtual clock counts MCLK cycles. Timer_B1-3, the ADC, eCOMP0,
+// eUSCI_A1 (UART), eUSCI_B1 (I2C master) and the RTC on the bus each
+// know when their next event is due, simAdvance() walks the clock from
+// one event to the next. Between events the firmware's ISRs run in
+// FR2355 priority order whenever GIE is set.
+//
+// Firmware time: an ISR costs Isr_Cycles (billed when it reads TB2R the
+// second time, PROF_EXIT, or when it returns), main() costs MAIN_SLICE
+// each time it turns interrupts back on. The ISRs main() held
+// off run inside that slice, so their latency shows up like it would on
+// the part. Both are estimates for the MSP430 build, not measured from
+// it, so the ISR times and latencies the run reports are only as good
+// as Isr_Cycles.
+//--------------------------------------------------------------------
+
+#include <setjmp.h>
+#include "msp430.h"
+#include "sim.h"
+
+// Timing Model
+#define ISR_ENTRY 6                       // cycles to accept an interrupt
+#define ISR_RETI 5                        // cycles for RETI
+#define MAIN_SLICE 400                    // main() between two __enable_interrupt()
+static const unsigned long Isr_Cycles[SRC_COUNT] = {
+    180,                                  // ISR_TB3_CCR0, a step and the ramp lookup
+    220,                                  // ISR_TB3_CCRn, tickTask() debouncing both switches
+    90,                                   // ISR_EUSCI_A1, one char
+    60,                                   // EUSCI_B1_I2C_ISR, one byte or flag
+    120,                                  // ADC_ISR, sample into the block
+    110,                                  // ECOMP0_ISR, coils off and the queues dropped
+};
+#define ADC_CONVERT 14                    // ADCCLK cycles to convert 12 bits after sampling
+#define COMP_STEP_NS 1000                 // P1.1 is looked at every us
+#define RTC_ADDR 0x68
+#define RTC_REGS 0x14                     // PCF8523 style map, time at 0x03-0x09
+#define CLTO_US 28000                     // UCCLTO_1 clock low timeout
+
+// Firmware ISRs, called by name since #pragma vector means nothing here
+void ISR_TB3_CCR0(void);
+void ISR_TB3_CCRn(void);
+void ISR_EUSCI_A1(void);
+void EUSCI_B1_I2C_ISR(void);
+void ADC_ISR(void);
+void ECOMP0_ISR(void);
+static void (*const Isr_Table[SRC_COUNT])(void) = {ISR_TB3_CCR0, ISR_TB3_CCRn, ISR_EUSCI_A1,
+                                                   EUSCI_B1_I2C_ISR, ADC_ISR, ECOMP0_ISR};
+const char *const Sim_Source_Names[SRC_COUNT] = {"TB3 CCR0", "TB3 CCRn", "UART A1 ",
+                                                 "I2C B1  ", "ADC     ", "eCOMP0  "};
+
+// Registers
+volatile unsigned short WDTCTL, PM5CTL0, SYSCFG0, FRCTL0;
+volatile unsigned short CSCTL0, CSCTL1, CSCTL2, CSCTL3, CSCTL4, CSCTL5, CSCTL6, CSCTL7;
+volatile unsigned short P1IN, P1OUT, P1DIR, P1REN, P1SEL0, P1SEL1;
+volatile unsigned short P2IN, P2OUT, P2DIR, P2REN, P2SEL0, P2SEL1;
+volatile unsigned short P3IN, P3OUT, P3DIR, P3REN, P3SEL0, P3SEL1;
+volatile unsigned short P4IN, P4OUT, P4DIR, P4REN, P4SEL0, P4SEL1;
+volatile unsigned short P6IN, P6OUT, P6DIR, P6REN, P6SEL0, P6SEL1;
+volatile unsigned short TB1CTL, TB1EX0, TB1CCTL0, TB1CCTL1, TB1CCTL2, TB1CCR0, TB1CCR1, TB1CCR2;
+volatile unsigned short TB2CTL, TB2EX0, TB2CCTL0, TB2CCTL1, TB2CCTL2, TB2CCR0, TB2CCR1, TB2CCR2;
+volatile unsigned short TB3CTL, TB3EX0, TB3CCTL0, TB3CCTL1, TB3CCTL2, TB3CCTL3, TB3CCTL4,
+                        TB3CCTL5, TB3CCTL6, TB3CCR0, TB3CCR1, TB3CCR2, TB3CCR3, TB3CCR4,
+                        TB3CCR5, TB3CCR6;
+volatile unsigned short ADCCTL0, ADCCTL1, ADCCTL2, ADCMCTL0, ADCIE, ADCIFG, ADCLO, ADCHI;
+volatile unsigned short UCA1CTLW0, UCA1BRW, UCA1MCTLW, UCA1STATW, UCA1IE, UCA1IFG;
+volatile unsigned short UCB1CTLW0, UCB1CTLW1, UCB1BRW, UCB1STATW, UCB1TBCNT, UCB1I2CSA,
+                        UCB1IE, UCB1IFG;
+volatile unsigned short CP0CTL0, CP0CTL1, CP0INT, CP0DACCTL, CP0DACDATA;
+
+// Measurements
+unsigned long long simNow = 0;
+SimStat simLatency[SRC_COUNT];
+SimStat simIsrTime[SRC_COUNT];
+SimStat simAdcInterval;
+SimStat simI2cTime;
+unsigned long simAdcOverruns = 0;
+unsigned long simAdcMissed = 0;
+unsigned long simAdcHeld = 0;
+unsigned long simUartOverruns = 0;
+unsigned long simUartBytes = 0;
+unsigned long simI2cNacks = 0;
+unsigned int simRtcNack = 0;
+double simRtcHold = 0;
+unsigned long long simCompCross = 0;
+
+// CPU
+static unsigned int simSr = 0;
+static int simInIsr = 0;
+static unsigned int simExitBis, simExitBic;   // SR bits the ISR changes on RETI
+static unsigned long long simIsrCost, simIsrBilled;
+static unsigned int simIsrReads;              // TB2R reads in this ISR
+static int Pending[SRC_COUNT];
+static unsigned long long Pending_Since[SRC_COUNT];
+static double simEnd;                         // seconds
+static jmp_buf simExit;
+
+static void simAdvance(unsigned long long target);
+
+//--------------- Clock ----------------------------------------------
+// MCLK = SMCLK = DCOCLKDIV = 32768 * (FLLN+1), the FLL locks at once
+//--------------------------------------------------------------------
+
+unsigned long simMclkHz(void){
+    return 32768UL * ((CSCTL2 & FLLN) + 1);
+}
+
+double simUs(unsigned long long cycles){
+    return cycles * 1e6 / simMclkHz();
+}
+
+unsigned long long simCycles(double seconds){
+    return (unsigned long long)(seconds * simMclkHz() + 0.5);
+}
+
+void statAdd(SimStat *stat, unsigned long long value){
+    if(stat->count == 0 || value < stat->min){
+        stat->min = value;
+    }
+    if(value > stat->max){
+        stat->max = value;
+    }
+    stat->count++;
+    stat->sum += value;
+}
+
+//--------------- Timer_B --------------------------------------------
+// Counts SMCLK / ID / (TBIDEX+1). Each count that lands on a CCRn sets
+// its CCIFG, TB1.1 in OUTMOD_7 rises at CCR0 and triggers the ADC.
+//--------------------------------------------------------------------
+
+typedef struct {
+    volatile unsigned short *ctl;
+    volatile unsigned short *ex0;
+    volatile unsigned short *ccr[7];
+    volatile unsigned short *cctl[7];
+    unsigned int channels;
+    unsigned int r;                       // TBxR
+    unsigned int mode;                    // MC bits it runs with
+    unsigned long long next;              // cycle of the next count
+    unsigned long long match[7];          // cycle each channel last matched
+    int out1;                             // TBx.1 output
+} SimTimer;
+
+static SimTimer Timer[4] = {
+    {0},
+    {&TB1CTL, &TB1EX0, {&TB1CCR0, &TB1CCR1, &TB1CCR2}, {&TB1CCTL0, &TB1CCTL1, &TB1CCTL2}, 3},
+    {&TB2CTL, &TB2EX0, {&TB2CCR0, &TB2CCR1, &TB2CCR2}, {&TB2CCTL0, &TB2CCTL1, &TB2CCTL2}, 3},
+    {&TB3CTL, &TB3EX0,
+     {&TB3CCR0, &TB3CCR1, &TB3CCR2, &TB3CCR3, &TB3CCR4, &TB3CCR5, &TB3CCR6},
+     {&TB3CCTL0, &TB3CCTL1, &TB3CCTL2, &TB3CCTL3, &TB3CCTL4, &TB3CCTL5, &TB3CCTL6}, 7},
+};
+
+static void adcTrigger(unsigned long long at);
+
+unsigned int simTimerDiv(int timer){
+    SimTimer *t = &Timer[timer];
+
+    return (1u << ((*t->ctl >> 6) & 3)) * ((*t->ex0 & 7) + 1);
+}
+
+unsigned long long simTimerMatch(int timer, int channel){
+    return Timer[timer].match[channel];
+}
+
+static void timerSync(int timer){
+    SimTimer *t = &Timer[timer];
+    unsigned int mode = *t->ctl & MC__UPDOWN;
+
+    if(*t->ctl & TBCLR){
+        *t->ctl &= ~TBCLR;                // clears itself
+        t->r = 0;
+        t->next = simNow + simTimerDiv(timer);
+    }
+    if(mode != t->mode){
+        if(t->mode == MC__STOP){
+            t->next = simNow + simTimerDiv(timer);
+        }
+        t->mode = mode;
+    }
+}
+
+// counts until TBxR gets to value, 0 if it never does
+static unsigned int timerDistance(SimTimer *t, unsigned int value){
+    unsigned int top = *t->ccr[0];
+
+    if(t->mode == MC__UP && t->r <= top){
+        if(value > top){
+            return 0;
+        }
+        return (value > t->r) ? value - t->r : top + 1 - t->r + value;
+    }
+    return ((value - t->r - 1) & 0xFFFF) + 1;
+}
+
+static unsigned long long timerNext(int timer){
+    SimTimer *t = &Timer[timer];
+    unsigned long long best = NEVER, at;
+    unsigned int n, d;
+
+    if(t->mode == MC__STOP){
+        return NEVER;
+    }
+    for(n=0; n<t->channels; n++){
+        d = timerDistance(t, *t->ccr[n]);
+        if(d != 0){
+            at = t->next + (unsigned long long)(d-1) * simTimerDiv(timer);
+            if(at < best){
+                best = at;
+            }
+        }
+    }
+    return best;
+}
+
+// simAdvance() never steps past a compare, so only the last count can match
+static void timerAdvance(int timer){
+    SimTimer *t = &Timer[timer];
+    unsigned long long k, at, div;
+    unsigned int n, top = *t->ccr[0];
+
+    if(t->mode == MC__STOP || simNow < t->next){
+        return;
+    }
+    div = simTimerDiv(timer);
+    k = (simNow - t->next) / div + 1;
+    at = t->next + (k-1) * div;
+    t->next += k * div;
+    if(t->mode == MC__UP && t->r <= top){
+        t->r = (t->r + k) % (top + 1);
+    }else{
+        t->r = (t->r + k) & 0xFFFF;
+    }
+
+    for(n=0; n<t->channels; n++){
+        if(t->r == *t->ccr[n]){
+            *t->cctl[n] |= CCIFG;
+            t->match[n] = at;
+        }
+    }
+    if(timer == 1 && (*t->cctl[1] & OUTMOD_7) == OUTMOD_7){
+        if(t->r == *t->ccr[1]){
+            t->out1 = 0;                  // reset at CCR1
+        }
+        if(t->r == top){
+            if(!t->out1){
+                adcTrigger(at);           // set at CCR0, the rising edge
+            }
+            t->out1 = 1;
+        }
+    }
+}
+
+unsigned short sim_TBR(int timer){
+    // PROF_EXIT is the second read, the ISR has done its work by then
+    if(timer == 2 && simInIsr && simIsrReads++ > 0 && simIsrBilled < simIsrCost){
+        unsigned long long left = simIsrCost - simIsrBilled;
+        simIsrBilled = simIsrCost;
+        simAdvance(simNow + left);
+    }
+    return Timer[timer].r;
+}
+
+unsigned short sim_TBIV(int timer){
+    SimTimer *t = &Timer[timer];
+    unsigned int n;
+
+    for(n=1; n<t->channels; n++){
+        if((*t->cctl[n] & (CCIE | CCIFG)) == (CCIE | CCIFG)){
+            *t->cctl[n] &= ~CCIFG;
+            return n*2;
+        }
+    }
+    if((*t->ctl & (TBIE | TBIFG)) == (TBIE | TBIFG)){
+        *t->ctl &= ~TBIFG;
+        return 0x0E;
+    }
+    return 0;
+}
+
+//--------------- ADC ------------------------------------------------
+// One conversion per TB1.1 rising edge (ADCSHS_2), sampled for ADCSHT
+// then converted, both on SMCLK / ADCDIV. P1.4 is read at the end of
+// the sample time. The single conversion modes (CONSEQ_0/1) take one
+// trigger and then ignore the rest until ENC is cleared and set again,
+// the repeat modes take every trigger.
+//--------------------------------------------------------------------
+
+static struct {
+    int busy;
+    int held;                             // single conversion done, waits for ENC
+    unsigned long long sampled;           // sample and hold closes
+    unsigned long long done;
+    unsigned long long last;              // previous trigger
+    unsigned short mem;
+} Adc;
+
+static void adcTrigger(unsigned long long at){
+    static const unsigned int Sht[16] = {4, 8, 16, 32, 64, 96, 128, 192,
+                                         256, 384, 512, 768, 1024, 1024, 1024, 1024};
+    static const unsigned int Pdiv[4] = {1, 4, 64, 1};
+    unsigned int div;
+
+    if(!(ADCCTL0 & ADCON) || !(ADCCTL0 & ADCENC) || (ADCCTL1 & ADCSHS) != ADCSHS_2){
+        return;
+    }
+    if(Adc.held){
+        simAdcHeld++;
+        return;
+    }
+    if(Adc.busy){
+        simAdcMissed++;
+        return;
+    }
+    if(!(ADCCTL1 & ADCCONSEQ_2)){
+        Adc.held = 1;
+    }
+    if(Adc.last != 0){
+        statAdd(&simAdcInterval, at - Adc.last);
+    }
+    Adc.last = at;
+
+    div = (((ADCCTL1 & ADCDIV) >> 5) + 1) * Pdiv[(ADCCTL2 & ADCPDIV) >> 8];
+    Adc.sampled = at + (unsigned long long)Sht[(ADCCTL0 & ADCSHT) >> 8] * div;
+    Adc.done = Adc.sampled + ADC_CONVERT * div;
+    Adc.busy = 1;
+    ADCCTL1 |= ADCBUSY;
+}
+
+static void adcSync(void){
+    if(!(ADCCTL0 & ADCENC)){
+        Adc.held = 0;
+    }
+}
+
+static unsigned long long adcNext(void){
+    return Adc.busy ? Adc.done : NEVER;
+}
+
+static void adcAdvance(void){
+    unsigned int value;
+
+    if(!Adc.busy || simNow < Adc.done){
+        return;
+    }
+    value = scenarioAnalog(Adc.sampled);
+    if(ADCIFG & ADCIFG0){
+        ADCIFG |= ADCOVIFG;
+        simAdcOverruns++;
+    }
+    Adc.mem = (value > 4095) ? 4095 : value;
+    ADCIFG |= ADCIFG0;
+    Adc.busy = 0;
+    ADCCTL1 &= ~ADCBUSY;
+}
+
+unsigned short sim_ADCMEM0(void){
+    ADCIFG &= ~ADCIFG0;
+    return Adc.mem;
+}
+
+unsigned short sim_ADCIV(void){
+    unsigned int flags = ADCIE & ADCIFG;
+
+    if(flags & ADCOVIFG){
+        ADCIFG &= ~ADCOVIFG;
+        return 0x02;
+    }
+    if(flags & ADCIFG0){
+        ADCIFG &= ~ADCIFG0;
+        return 0x0C;
+    }
+    return 0;
+}
+
+//--------------- eCOMP0 ---------------------------------------------
+// P1.1 against the 6-bit DAC (64 ADC counts a step). CPOUT picks DAC
+// buffer 1 or 2 unless CPDACBUFS hands that to CPDACSW. Falls back
+// under the level by the CPHSEL hysteresis, a change has to hold for
+// the CPFLTDLY time before CPOUT follows it.
+//--------------------------------------------------------------------
+
+static struct {
+    unsigned long long next;
+    int raw;                              // comparison before the filter
+    int changing;
+    unsigned long long since;
+} Comp = {NEVER};
+
+static void compSync(void){
+    if(!(CP0CTL1 & CPEN)){
+        Comp.next = NEVER;
+    }else if(Comp.next == NEVER){
+        Comp.next = simNow;
+    }
+}
+
+static void compAdvance(void){
+    static const unsigned int Hyst_Counts[4] = {0, 12, 25, 37};     // 0, 10, 20, 30 mV of 3.3 V
+    static const unsigned int Filter_Ns[4] = {450, 900, 1800, 3600};
+    unsigned int v, code, ref, hyst, buffer;
+    unsigned long long filter;
+    int out = (CP0CTL1 & CPOUT) != 0;
+    int raw;
+
+    if(Comp.next == NEVER || simNow < Comp.next){
+        return;
+    }
+    v = scenarioAnalog(simNow);
+    buffer = (CP0DACCTL & CPDACBUFS) ? ((CP0DACCTL & CPDACSW) != 0) : out;
+    code = buffer ? (CP0DACDATA >> 8) & 0x3F : CP0DACDATA & 0x3F;
+    ref = (CP0DACCTL & CPDACEN) ? code * 64 : 0;
+    hyst = Hyst_Counts[(CP0CTL1 >> 10) & 3];
+    raw = out ? (v + hyst > ref) : (v > ref);
+
+    if(raw && !out && !Comp.raw){
+        simCompCross = simNow;
+    }
+    Comp.raw = raw;
+
+    if(raw != out){
+        if(!Comp.changing){
+            Comp.changing = 1;
+            Comp.since = simNow;
+        }
+        filter = (CP0CTL1 & CPFLT) ? Filter_Ns[(CP0CTL1 >> 6) & 3] * (unsigned long long)simMclkHz() / 1000000000ULL : 0;
+        if(simNow - Comp.since >= filter){
+            Comp.changing = 0;
+            if(raw){
+                CP0CTL1 |= CPOUT;
+                CP0INT |= (CP0CTL1 & CPIES) ? CPIIFG : CPIFG;
+            }else{
+                CP0CTL1 &= ~CPOUT;
+                CP0INT |= (CP0CTL1 & CPIES) ? CPIFG : CPIIFG;
+            }
+        }
+    }else{
+        Comp.changing = 0;
+    }
+    Comp.next = simNow + ((unsigned long long)simMclkHz() * COMP_STEP_NS + 999999999ULL) / 1000000000ULL;
+}
+
+unsigned short sim_CP0IV(void){
+    unsigned int flags = (CP0INT >> 8) & CP0INT;
+
+    if(flags & CPIFG){
+        CP0INT &= ~CPIFG;
+        return 0x02;
+    }
+    if(flags & CPIIFG){
+        CP0INT &= ~CPIIFG;
+        return 0x04;
+    }
+    return 0;
+}
+
+//--------------- eUSCI_A1, UART -------------------------------------
+// TXBUF feeds the shift register, TXIFG is up while TXBUF is empty.
+// A frame is start, 8 data and stop bits, each 16*UCBR+UCBRF BRCLKs
+// plus the UCBRS bit for its position. Any read of UCA1IV clears the
+// flag it returns, TXIFG included.
+//--------------------------------------------------------------------
+
+static struct {
+    volatile unsigned short latch;        // what the firmware wrote to TXBUF
+    int pending;                          // latch not picked up yet
+    int full;                             // TXBUF holds a char
+    unsigned char buf;
+    int shifting;
+    unsigned char shift;
+    unsigned long long end;               // stop bit done
+    unsigned char rx;
+} A1;
+
+static unsigned long long uartFrame(void){
+    unsigned int n, bit, brs = UCA1MCTLW >> 8;
+    unsigned long long total = 0;
+
+    for(n=0; n<10; n++){
+        bit = (UCA1MCTLW & UCOS16) ? 16*UCA1BRW + ((UCA1MCTLW >> 4) & 0xF) : UCA1BRW;
+        total += bit + ((brs >> (7 - (n & 7))) & 1);
+    }
+    return total;
+}
+
+double simUartBaud(void){
+    return 10.0 * simMclkHz() / uartFrame();
+}
+
+static void a1Shift(void){
+    A1.shift = A1.buf;
+    A1.full = 0;
+    A1.shifting = 1;
+    A1.end = simNow + uartFrame();
+    UCA1IFG |= UCTXIFG;                   // TXBUF empty again
+}
+
+static void a1Sync(void){
+    if(UCA1CTLW0 & UCSWRST){
+        UCA1IFG = UCTXIFG;
+        UCA1STATW = 0;
+        A1.pending = 0;
+        A1.full = 0;
+        A1.shifting = 0;
+        return;
+    }
+    if(A1.pending){
+        A1.pending = 0;
+        A1.buf = A1.latch;
+        A1.full = 1;
+    }
+    if(A1.full && !A1.shifting){
+        a1Shift();
+    }
+}
+
+static unsigned long long a1Next(void){
+    return A1.shifting ? A1.end : NEVER;
+}
+
+static void a1Advance(void){
+    if(!A1.shifting || simNow < A1.end){
+        return;
+    }
+    A1.shifting = 0;
+    simUartBytes++;
+    scenarioUartTx(A1.shift);
+    if(A1.full){
+        a1Shift();
+    }
+}
+
+volatile unsigned short *sim_UCA1TXBUF(void){
+    if(A1.pending){
+        A1.buf = A1.latch;                // written twice, the first one is lost
+        A1.full = 1;
+    }
+    A1.pending = 1;
+    UCA1IFG &= ~UCTXIFG;
+    return &A1.latch;
+}
+
+unsigned short sim_UCA1RXBUF(void){
+    UCA1IFG &= ~UCRXIFG;
+    return A1.rx;
+}
+
+unsigned short sim_UCA1IV(void){
+    unsigned int flags = UCA1IE & UCA1IFG;
+
+    if(flags & UCRXIFG){
+        UCA1IFG &= ~UCRXIFG;
+        return 0x02;
+    }
+    if(flags & UCTXIFG){
+        UCA1IFG &= ~UCTXIFG;
+        return 0x04;
+    }
+    return 0;
+}
+
+// the stop bit of a char from the terminal just went by
+void simUartReceive(unsigned char c){
+    if(UCA1CTLW0 & UCSWRST){
+        return;
+    }
+    if(UCA1IFG & UCRXIFG){
+        UCA1STATW |= UCOE;
+        simUartOverruns++;
+    }
+    A1.rx = c;
+    UCA1IFG |= UCRXIFG;
+}
+
+//--------------- eUSCI_B1, I2C master and the RTC --------------------
+// SCL = SMCLK / UCB1BRW. START and address take 10 clocks, a byte and
+// its ACK 9. The master holds SCL low while TXBUF is empty or RXBUF is
+// still full, and gives up with CLTOIFG after the clock low timeout.
+// UCTXSTP asked for during a received byte NACKs it and sends the STOP.
+// The only slave is the RTC, with a register pointer that the first
+// byte written sets and every byte after moves on. The scenario can make
+// it leave its address unanswered (simRtcNack) or hold SCL low after it
+// (simRtcHold), a STOP asked for meanwhile goes out once it lets go.
+//--------------------------------------------------------------------
+
+#define BUS_IDLE 0
+#define BUS_ADDR 1                        // START and address going out
+#define BUS_TX 2                          // byte going out
+#define BUS_HOLD 3                        // SCL low, waiting on TXBUF, STOP or START
+#define BUS_RX 4                          // byte coming in
+#define BUS_RXWAIT 5                      // byte in, RXBUF still full
+#define BUS_NACKED 6                      // waiting on STOP after a NACK
+#define BUS_STOP 7                        // STOP going out
+#define BUS_STRETCH 8                     // the RTC holds SCL low after its address
+
+static struct {
+    int state;
+    int read;
+    int first;                            // next byte written is the register address
+    unsigned long long next;              // end of the current bus step
+    unsigned long long start;             // START of the transfer
+    unsigned long long hold;              // SCL went low waiting
+    int timedOut;
+    volatile unsigned short latch;
+    int pending;
+    int full;
+    unsigned char buf;
+    unsigned char shift;
+    unsigned char rx;
+    int rxFull;
+    unsigned char held;                   // byte waiting on RXBUF
+} B1;
+
+static struct {
+    unsigned char reg[RTC_REGS];
+    unsigned int ptr;
+    unsigned long long tick;              // next second
+} Rtc = {{0}, 0, NEVER};
+
+double simI2cHz(void){
+    return UCB1BRW ? (double)simMclkHz() / UCB1BRW : 0;
+}
+
+static void rtcRegWrite(unsigned char value){
+    if(B1.first){
+        B1.first = 0;
+        Rtc.ptr = value % RTC_REGS;
+        return;
+    }
+    Rtc.reg[Rtc.ptr] = value;
+    if(Rtc.ptr == 0x03){
+        Rtc.tick = simNow + simCycles(1.0);   // writing the seconds restarts the divider
+    }
+    Rtc.ptr = (Rtc.ptr+1) % RTC_REGS;
+}
+
+static unsigned char rtcRegRead(void){
+    unsigned char value = Rtc.reg[Rtc.ptr];
+
+    Rtc.ptr = (Rtc.ptr+1) % RTC_REGS;
+    return value;
+}
+
+// BCD count up, returns 1 when it wraps past last
+static int bcdTick(unsigned char *value, unsigned char mask, unsigned int last){
+    unsigned int n = ((*value & mask) >> 4) * 10 + (*value & 0x0F) + 1;
+
+    if(n > last){
+        n = 0;
+    }
+    *value = (*value & ~mask) | ((n / 10) << 4) | (n % 10);
+    return n == 0;
+}
+
+static void rtcAdvance(void){
+    if(Rtc.tick == NEVER || simNow < Rtc.tick){
+        return;
+    }
+    Rtc.tick += simCycles(1.0);
+    if(bcdTick(&Rtc.reg[0x03], 0x7F, 59) && bcdTick(&Rtc.reg[0x04], 0x7F, 59)){
+        bcdTick(&Rtc.reg[0x05], 0x3F, 23);
+    }
+}
+
+static void b1Start(void){
+    B1.state = BUS_ADDR;
+    B1.read = !(UCB1CTLW0 & UCTR);
+    B1.next = simNow + 10*UCB1BRW;
+    if(!B1.read){
+        UCB1IFG |= UCTXIFG0;              // first byte can go in TXBUF right away
+    }
+}
+
+static void b1Stop(unsigned int clocks){
+    B1.state = BUS_STOP;
+    B1.next = simNow + clocks*UCB1BRW;
+}
+
+static void b1Hold(void){
+    B1.state = BUS_HOLD;
+    B1.hold = simNow;
+    B1.timedOut = 0;
+}
+
+// after a byte went out, or while SCL is held
+static void b1Continue(void){
+    if(UCB1CTLW0 & UCTXSTP){
+        b1Stop(1);
+    }else if(UCB1CTLW0 & UCTXSTT){
+        b1Start();                        // repeated start
+    }else if(B1.full){
+        B1.full = 0;
+        B1.shift = B1.buf;
+        B1.state = BUS_TX;
+        B1.next = simNow + 9*UCB1BRW;
+        UCB1IFG |= UCTXIFG0;
+    }else if(B1.state != BUS_HOLD){
+        b1Hold();
+    }
+}
+
+static void b1Received(unsigned char value){
+    B1.rx = value;
+    B1.rxFull = 1;
+    UCB1IFG |= UCRXIFG0;
+    if(UCB1CTLW0 & UCTXSTP){
+        b1Stop(2);                        // NACK then STOP
+    }else{
+        B1.state = BUS_RX;
+        B1.next = simNow + 9*UCB1BRW;     // ACK then the next byte
+    }
+}
+
+static void b1Sync(void){
+    if(UCB1CTLW0 & UCSWRST){
+        B1.state = BUS_IDLE;
+        B1.pending = 0;
+        B1.full = 0;
+        B1.rxFull = 0;
+        UCB1IFG = 0;
+        UCB1STATW = 0;
+        return;
+    }
+    if(B1.pending){
+        B1.pending = 0;
+        B1.buf = B1.latch;
+        B1.full = 1;
+    }
+    switch(B1.state){
+    case BUS_IDLE:
+        if((UCB1CTLW0 & (UCMST | UCTXSTT)) == (UCMST | UCTXSTT)){
+            B1.start = simNow;
+            UCB1STATW |= UCBBUSY;
+            b1Start();
+        }
+        break;
+    case BUS_HOLD:
+        b1Continue();
+        break;
+    case BUS_NACKED:
+        if(UCB1CTLW0 & UCTXSTP){
+            b1Stop(1);
+        }
+        break;
+    case BUS_RXWAIT:
+        if(!B1.rxFull){
+            b1Received(B1.held);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static unsigned long long b1Clto(void){
+    return (UCB1CTLW1 & UCCLTO_3) ? simCycles(CLTO_US / 1e6) : NEVER;
+}
+
+static unsigned long long b1Next(void){
+    switch(B1.state){
+    case BUS_ADDR:
+    case BUS_TX:
+    case BUS_RX:
+    case BUS_STOP:
+        return B1.next;
+    case BUS_STRETCH:
+        if(B1.timedOut || b1Clto() == NEVER || B1.next < B1.hold + b1Clto()){
+            return B1.next;
+        }
+        return B1.hold + b1Clto();
+    case BUS_HOLD:
+    case BUS_RXWAIT:
+        return (B1.timedOut || b1Clto() == NEVER) ? NEVER : B1.hold + b1Clto();
+    default:
+        return NEVER;
+    }
+}
+
+static void b1Advance(void){
+    unsigned char value;
+
+    if(b1Next() == NEVER || simNow < b1Next()){
+        return;
+    }
+    switch(B1.state){
+    case BUS_ADDR:
+        UCB1CTLW0 &= ~UCTXSTT;            // address is out
+        if((UCB1I2CSA & 0x7F) != RTC_ADDR || simRtcNack > 0){
+            if(simRtcNack > 0){
+                simRtcNack--;
+            }
+            simI2cNacks++;
+            UCB1IFG |= UCNACKIFG;
+            B1.state = BUS_NACKED;
+        }else if(simRtcHold > 0){
+            B1.state = BUS_STRETCH;
+            B1.next = simNow + simCycles(simRtcHold);
+            B1.hold = simNow;
+            B1.timedOut = 0;
+            simRtcHold = 0;
+        }else if(B1.read){
+            B1.state = BUS_RX;
+            B1.next = simNow + 8*UCB1BRW;
+        }else{
+            B1.first = 1;
+            b1Continue();
+        }
+        break;
+    case BUS_TX:
+        rtcRegWrite(B1.shift);
+        b1Continue();
+        break;
+    case BUS_RX:
+        value = rtcRegRead();
+        if(B1.rxFull){
+            B1.held = value;
+            B1.state = BUS_RXWAIT;
+            B1.hold = simNow;
+            B1.timedOut = 0;
+        }else{
+            b1Received(value);
+        }
+        break;
+    case BUS_STRETCH:
+        if(simNow < B1.next){
+            B1.timedOut = 1;              // SCL held too long
+            UCB1IFG |= UCCLTOIFG;
+        }else if(UCB1CTLW0 & UCTXSTP){
+            b1Stop(1);
+        }else if(B1.read){
+            B1.state = BUS_RX;
+            B1.next = simNow + 8*UCB1BRW;
+        }else{
+            B1.first = 1;
+            b1Continue();
+        }
+        break;
+    case BUS_STOP:
+        B1.state = BUS_IDLE;
+        UCB1CTLW0 &= ~(UCTXSTP | UCTXSTT);
+        UCB1STATW &= ~UCBBUSY;
+        UCB1IFG |= UCSTPIFG;
+        statAdd(&simI2cTime, simNow - B1.start);
+        break;
+    default:                              // SCL held too long
+        B1.timedOut = 1;
+        UCB1IFG |= UCCLTOIFG;
+        break;
+    }
+}
+
+volatile unsigned short *sim_UCB1TXBUF(void){
+    if(B1.pending){
+        B1.buf = B1.latch;
+        B1.full = 1;
+    }
+    B1.pending = 1;
+    UCB1IFG &= ~UCTXIFG0;
+    return &B1.latch;
+}
+
+unsigned short sim_UCB1RXBUF(void){
+    UCB1IFG &= ~UCRXIFG0;
+    B1.rxFull = 0;
+    return B1.rx;
+}
+
+unsigned short sim_UCB1IV(void){
+    static const unsigned short Iv_Flags[8] = {UCALIFG, UCNACKIFG, UCSTTIFG, UCSTPIFG,
+                                               UCRXIFG0, UCTXIFG0, UCBCNTIFG, UCCLTOIFG};
+    static const unsigned short Iv_Values[8] = {0x02, 0x04, 0x06, 0x08, 0x16, 0x18, 0x1A, 0x1C};
+    unsigned int n, flags = UCB1IE & UCB1IFG;
+
+    for(n=0; n<8; n++){
+        if(flags & Iv_Flags[n]){
+            UCB1IFG &= ~Iv_Flags[n];
+            return Iv_Values[n];
+        }
+    }
+    return 0;
+}
+
+//--------------- CRC16 ----------------------------------------------
+// Bytes in through CRCDIRB_L, CRC-CCITT (0x1021, MSB first) out of
+// CRCINIRES. A byte is folded in on the next CRC access, the write
+// itself goes through the pointer the access returns.
+//--------------------------------------------------------------------
+
+static volatile unsigned char crcLatch;
+static int crcPending = 0;
+static volatile unsigned short crcReg = 0xFFFF;
+
+static void crcFold(void){
+    unsigned int n, crc = crcReg;
+
+    if(!crcPending){
+        return;
+    }
+    crcPending = 0;
+    crc ^= (unsigned int)crcLatch << 8;
+    for(n=0; n<8; n++){
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    crcReg = crc & 0xFFFF;
+}
+
+volatile unsigned char *sim_CRCDIRB_L(void){
+    crcFold();
+    crcPending = 1;
+    return &crcLatch;
+}
+
+volatile unsigned short *sim_CRCINIRES(void){
+    crcFold();
+    return &crcReg;
+}
+
+//--------------- Interrupts -----------------------------------------
+
+static int srcPending(int source){
+    unsigned int n;
+
+    switch(source){
+    case SRC_TB3_0:
+        return (TB3CCTL0 & (CCIE | CCIFG)) == (CCIE | CCIFG);
+    case SRC_TB3_N:
+        for(n=1; n<7; n++){
+            if((*Timer[3].cctl[n] & (CCIE | CCIFG)) == (CCIE | CCIFG)){
+                return 1;
+            }
+        }
+        return (TB3CTL & (TBIE | TBIFG)) == (TBIE | TBIFG);
+    case SRC_A1:
+        return (UCA1IE & UCA1IFG) != 0;
+    case SRC_B1:
+        return (UCB1IE & UCB1IFG) != 0;
+    case SRC_ADC:
+        return (ADCIE & ADCIFG) != 0;
+    case SRC_COMP:
+        return ((CP0INT >> 8) & CP0INT & (CPIFG | CPIIFG)) != 0;
+    default:
+        return 0;
+    }
+}
+
+// register writes the firmware made since the last look
+static void simSync(void){
+    unsigned int n;
+
+    for(n=1; n<4; n++){
+        timerSync(n);
+    }
+    adcSync();
+    compSync();
+    a1Sync();
+    b1Sync();
+}
+
+static void pendingUpdate(void){
+    int n, p;
+
+    for(n=0; n<SRC_COUNT; n++){
+        p = srcPending(n);
+        if(p && !Pending[n]){
+            Pending_Since[n] = simNow;
+        }
+        Pending[n] = p;
+    }
+}
+
+static unsigned long long simNextEvent(void){
+    unsigned long long best = NEVER, at;
+    unsigned int n;
+
+    for(n=1; n<4; n++){
+        at = timerNext(n);
+        if(at < best) best = at;
+    }
+    at = adcNext();
+    if(at < best) best = at;
+    if(Comp.next < best) best = Comp.next;
+    at = a1Next();
+    if(at < best) best = at;
+    at = b1Next();
+    if(at < best) best = at;
+    if(Rtc.tick < best) best = Rtc.tick;
+    at = scenarioNext();
+    if(at < best) best = at;
+    return best;
+}
+
+// runs the peripherals up to target, no firmware in between
+static void simAdvance(unsigned long long target){
+    unsigned long long at;
+    unsigned int n;
+
+    do{
+        simSync();
+        at = simNextEvent();
+        if(at > target){
+            at = target;
+        }
+        if(at > simNow){
+            simNow = at;
+        }
+        for(n=1; n<4; n++){
+            timerAdvance(n);
+        }
+        adcAdvance();
+        compAdvance();
+        a1Advance();
+        b1Advance();
+        rtcAdvance();
+        if(scenarioNext() <= simNow){
+            scenarioStep();
+        }
+        pendingUpdate();
+    }while(simNow < target);
+}
+
+// runs every ISR that's due, highest priority first
+static void simService(void){
+    unsigned long long entry;
+    unsigned int sr;
+    int n;
+
+    simSync();
+    pendingUpdate();
+    while((simSr & GIE) && !simInIsr){
+        for(n=0; n<SRC_COUNT && !srcPending(n); n++);
+        if(n == SRC_COUNT){
+            break;
+        }
+        sr = simSr;
+        simAdvance(simNow + ISR_ENTRY);
+        entry = simNow;
+        statAdd(&simLatency[n], entry - Pending_Since[n]);
+        Pending[n] = 0;
+        if(n == SRC_TB3_0){
+            TB3CCTL0 &= ~CCIFG;           // CCR0 has its own vector, the flag clears on entry
+        }
+
+        simInIsr = 1;
+        simSr = 0;
+        simExitBis = 0;
+        simExitBic = 0;
+        simIsrCost = Isr_Cycles[n];
+        simIsrBilled = 0;
+        simIsrReads = 0;
+        scenarioIsr(n, entry, 0);
+        Isr_Table[n]();
+        if(simIsrBilled < simIsrCost){
+            simAdvance(simNow + simIsrCost - simIsrBilled);
+        }
+        simAdvance(simNow + ISR_RETI);
+        simInIsr = 0;
+        simSr = (sr & ~simExitBic) | simExitBis;
+        statAdd(&simIsrTime[n], simNow - entry);
+        scenarioIsr(n, entry, 1);
+        simSync();
+        pendingUpdate();
+    }
+}
+
+// main() lets the clock run for cycles
+static void simRunFor(unsigned long long cycles){
+    unsigned long long target = simNow + cycles, at;
+
+    for(;;){
+        simService();
+        if(simNow >= target){
+            break;
+        }
+        at = simNextEvent();
+        simAdvance((at < target) ? at : target);
+    }
+}
+
+// main() reached an intrinsic, the run ends at one of these
+static void simMain(void){
+    simSync();
+    scenarioMain();
+    if(simNow >= simCycles(simEnd)){
+        longjmp(simExit, 1);
+    }
+}
+
+//--------------- Intrinsics -----------------------------------------
+
+void __enable_interrupt(void){
+    simSr |= GIE;
+    if(!simInIsr){
+        simMain();
+        simRunFor(MAIN_SLICE);
+    }
+}
+
+void __disable_interrupt(void){
+    simSr &= ~GIE;
+    if(!simInIsr){
+        simMain();
+    }
+}
+
+void __no_operation(void){
+}
+
+void __delay_cycles(unsigned long cycles){
+    simRunFor(cycles);
+}
+
+void __bis_SR_register(unsigned int bits){
+    unsigned long long at, end;
+
+    simSr |= bits;
+    if(simInIsr){
+        return;
+    }
+    simMain();
+    while(simSr & CPUOFF){                // LPM0 until an ISR clears CPUOFF on exit
+        simService();
+        if(!(simSr & CPUOFF)){
+            break;
+        }
+        end = simCycles(simEnd);
+        if(simNow >= end){
+            longjmp(simExit, 1);
+        }
+        at = simNextEvent();
+        simAdvance((at < end) ? at : end);
+    }
+}
+
+void __bic_SR_register(unsigned int bits){
+    simSr &= ~bits;
+}
+
+void __bis_SR_register_on_exit(unsigned int bits){
+    simExitBis |= bits;
+}
+
+void __bic_SR_register_on_exit(unsigned int bits){
+    simExitBic |= bits;
+}
+
+//--------------- simRun ---------------------------------------------
+// Powers up and runs the firmware for seconds of virtual time, returns
+// 0 once the time is up, -1 if the firmware returned from main()
+//--------------------------------------------------------------------
+
+int simRun(int (*firmware)(void), double seconds){
+    CSCTL2 = 0x101F;                      // 1 MHz out of reset
+    SYSCFG0 = PFWP | DFWP;
+    P1IN = P2IN = P3IN = P4IN = P6IN = 0xFF;  // pulled up, nothing pressed
+    UCA1CTLW0 = UCSWRST;
+    UCA1IFG = UCTXIFG;
+    UCB1CTLW0 = UCSWRST;
+    simEnd = seconds;
+
+    if(setjmp(simExit) == 0){
+        firmware();
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,281 @@
+//--------------------------------------------------------------------
+// msp430.h for the host build
+//--------------------------------------------------------------------
+// Stands in for TI's msp430fr2355.h when FinalProject9main.c is built
+// for Linux. Registers are plain variables that mcu.c reads and writes
+// between firmware steps, bit values are the FR2355 ones. Registers with
+// side effects on access (IV, RXBUF, TXBUF, ADCMEM0, the CRC, TBxR) go
+// through mcu.c so reading or writing them acts like the hardware does.
+//--------------------------------------------------------------------
+
+#ifndef SIM_MSP430_H
+#define SIM_MSP430_H
+
+#define __interrupt
+
+// Status Register
+#define GIE             0x0008
+#define CPUOFF          0x0010
+#define OSCOFF          0x0020
+#define SCG0            0x0040
+#define SCG1            0x0080
+#define LPM0_bits       (CPUOFF)
+#define LPM3_bits       (SCG1 | SCG0 | CPUOFF)
+
+void __enable_interrupt(void);
+void __disable_interrupt(void);
+void __no_operation(void);
+void __delay_cycles(unsigned long cycles);
+void __bis_SR_register(unsigned int bits);
+void __bic_SR_register(unsigned int bits);
+void __bis_SR_register_on_exit(unsigned int bits);
+void __bic_SR_register_on_exit(unsigned int bits);
+
+#define BIT0            0x0001
+#define BIT1            0x0002
+#define BIT2            0x0004
+#define BIT3            0x0008
+#define BIT4            0x0010
+#define BIT5            0x0020
+#define BIT6            0x0040
+#define BIT7            0x0080
+
+// Watchdog, Power, FRAM
+extern volatile unsigned short WDTCTL;
+extern volatile unsigned short PM5CTL0;
+extern volatile unsigned short SYSCFG0;
+extern volatile unsigned short FRCTL0;
+#define WDTPW           0x5A00
+#define WDTHOLD         0x0080
+#define LOCKLPM5        0x0001
+#define FRWPPW          0xA500
+#define PFWP            0x0001
+#define DFWP            0x0002
+#define FRCTLPW         0xA500
+#define NWAITS_0        0x0000
+#define NWAITS_1        0x0010
+#define NWAITS_2        0x0020
+
+// Clock System
+extern volatile unsigned short CSCTL0, CSCTL1, CSCTL2, CSCTL3, CSCTL4, CSCTL5, CSCTL6, CSCTL7;
+#define DCORSEL_3       0x0006
+#define DCORSEL_5       0x000A
+#define DCORSEL_7       0x000E
+#define FLLD_0          0x0000
+#define FLLN            0x03FF
+#define SELREF__REFOCLK 0x0010
+#define SELMS__DCOCLKDIV 0x0000
+#define SELA__REFOCLK   0x0100
+#define FLLUNLOCK0      0x0100
+#define FLLUNLOCK1      0x0200
+
+// Ports
+extern volatile unsigned short P1IN, P1OUT, P1DIR, P1REN, P1SEL0, P1SEL1;
+extern volatile unsigned short P2IN, P2OUT, P2DIR, P2REN, P2SEL0, P2SEL1;
+extern volatile unsigned short P3IN, P3OUT, P3DIR, P3REN, P3SEL0, P3SEL1;
+extern volatile unsigned short P4IN, P4OUT, P4DIR, P4REN, P4SEL0, P4SEL1;
+extern volatile unsigned short P6IN, P6OUT, P6DIR, P6REN, P6SEL0, P6SEL1;
+
+// Timer_B
+extern volatile unsigned short TB1CTL, TB1EX0, TB1CCTL0, TB1CCTL1, TB1CCTL2, TB1CCR0, TB1CCR1, TB1CCR2;
+extern volatile unsigned short TB2CTL, TB2EX0, TB2CCTL0, TB2CCTL1, TB2CCTL2, TB2CCR0, TB2CCR1, TB2CCR2;
+extern volatile unsigned short TB3CTL, TB3EX0, TB3CCTL0, TB3CCTL1, TB3CCTL2, TB3CCTL3, TB3CCTL4,
+                               TB3CCTL5, TB3CCTL6, TB3CCR0, TB3CCR1, TB3CCR2, TB3CCR3, TB3CCR4,
+                               TB3CCR5, TB3CCR6;
+unsigned short sim_TBR(int timer);
+unsigned short sim_TBIV(int timer);
+#define TB1R            sim_TBR(1)
+#define TB2R            sim_TBR(2)
+#define TB3R            sim_TBR(3)
+#define TB1IV           sim_TBIV(1)
+#define TB2IV           sim_TBIV(2)
+#define TB3IV           sim_TBIV(3)
+#define TBIFG           0x0001
+#define TBIE            0x0002
+#define TBCLR           0x0004
+#define MC__STOP        0x0000
+#define MC__UP          0x0010
+#define MC__CONTINUOUS  0x0020
+#define MC__UPDOWN      0x0030
+#define ID__1           0x0000
+#define ID__2           0x0040
+#define ID__4           0x0080
+#define ID__8           0x00C0
+#define TBSSEL__ACLK    0x0100
+#define TBSSEL__SMCLK   0x0200
+#define TBIDEX_0        0x0000
+#define TBIDEX_1        0x0001
+#define TBIDEX_2        0x0002
+#define TBIDEX_3        0x0003
+#define TBIDEX_4        0x0004
+#define TBIDEX_5        0x0005
+#define TBIDEX_6        0x0006
+#define TBIDEX_7        0x0007
+#define CCIFG           0x0001
+#define COV             0x0002
+#define OUT             0x0004
+#define CCIE            0x0010
+#define OUTMOD_0        0x0000
+#define OUTMOD_1        0x0020
+#define OUTMOD_2        0x0040
+#define OUTMOD_3        0x0060
+#define OUTMOD_4        0x0080
+#define OUTMOD_5        0x00A0
+#define OUTMOD_6        0x00C0
+#define OUTMOD_7        0x00E0
+#define CAP             0x0100
+
+// ADC
+extern volatile unsigned short ADCCTL0, ADCCTL1, ADCCTL2, ADCMCTL0, ADCIE, ADCIFG, ADCLO, ADCHI;
+unsigned short sim_ADCMEM0(void);
+unsigned short sim_ADCIV(void);
+#define ADCMEM0         sim_ADCMEM0()
+#define ADCIV           sim_ADCIV()
+#define ADCSC           0x0001
+#define ADCENC          0x0002
+#define ADCON           0x0010
+#define ADCMSC          0x0080
+#define ADCSHT          0x0F00
+#define ADCSHT_0        0x0000
+#define ADCSHT_1        0x0100
+#define ADCSHT_2        0x0200
+#define ADCSHT_3        0x0300
+#define ADCBUSY         0x0001
+#define ADCCONSEQ       0x0006
+#define ADCCONSEQ_0     0x0000
+#define ADCCONSEQ_1     0x0002
+#define ADCCONSEQ_2     0x0004
+#define ADCCONSEQ_3     0x0006
+#define ADCSSEL         0x0018
+#define ADCSSEL_0       0x0000
+#define ADCSSEL_1       0x0008
+#define ADCSSEL_2       0x0010
+#define ADCSSEL_3       0x0018
+#define ADCDIV          0x00E0
+#define ADCDIV_0        0x0000
+#define ADCDIV_1        0x0020
+#define ADCDIV_2        0x0040
+#define ADCDIV_3        0x0060
+#define ADCDIV_4        0x0080
+#define ADCDIV_5        0x00A0
+#define ADCDIV_6        0x00C0
+#define ADCDIV_7        0x00E0
+#define ADCSHP          0x0200
+#define ADCSHS          0x0C00
+#define ADCSHS_0        0x0000
+#define ADCSHS_1        0x0400
+#define ADCSHS_2        0x0800
+#define ADCSHS_3        0x0C00
+#define ADCRES          0x0030
+#define ADCRES_0        0x0000
+#define ADCRES_1        0x0010
+#define ADCRES_2        0x0020
+#define ADCPDIV         0x0300
+#define ADCINCH         0x000F
+#define ADCINCH_4       0x0004
+#define ADCIE0          0x0001
+#define ADCOVIE         0x0010
+#define ADCIFG0         0x0001
+#define ADCOVIFG        0x0010
+
+// eUSCI_A1, UART
+extern volatile unsigned short UCA1CTLW0, UCA1BRW, UCA1MCTLW, UCA1STATW, UCA1IE, UCA1IFG;
+volatile unsigned short *sim_UCA1TXBUF(void);
+unsigned short sim_UCA1RXBUF(void);
+unsigned short sim_UCA1IV(void);
+#define UCA1TXBUF       (*sim_UCA1TXBUF())
+#define UCA1RXBUF       sim_UCA1RXBUF()
+#define UCA1IV          sim_UCA1IV()
+#define UCSWRST         0x0001
+#define UCSSEL__SMCLK   0x0080
+#define UCOS16          0x0001
+#define UCRXIE          0x0001
+#define UCTXIE          0x0002
+#define UCRXIFG         0x0001
+#define UCTXIFG         0x0002
+#define UCOE            0x0020
+
+// eUSCI_B1, I2C
+extern volatile unsigned short UCB1CTLW0, UCB1CTLW1, UCB1BRW, UCB1STATW, UCB1TBCNT, UCB1I2CSA,
+                               UCB1IE, UCB1IFG;
+volatile unsigned short *sim_UCB1TXBUF(void);
+unsigned short sim_UCB1RXBUF(void);
+unsigned short sim_UCB1IV(void);
+#define UCB1TXBUF       (*sim_UCB1TXBUF())
+#define UCB1RXBUF       sim_UCB1RXBUF()
+#define UCB1IV          sim_UCB1IV()
+#define UCTXSTT         0x0002
+#define UCTXSTP         0x0004
+#define UCTXNACK        0x0008
+#define UCTR            0x0010
+#define UCSYNC          0x0100
+#define UCMODE_3        0x0600
+#define UCMST           0x0800
+#define UCASTP_2        0x0008
+#define UCCLTO_1        0x0040
+#define UCCLTO_2        0x0080
+#define UCCLTO_3        0x00C0
+#define UCBBUSY         0x0010
+#define UCRXIE0         0x0001
+#define UCTXIE0         0x0002
+#define UCSTTIE         0x0004
+#define UCSTPIE         0x0008
+#define UCALIE          0x0010
+#define UCNACKIE        0x0020
+#define UCBCNTIE        0x0040
+#define UCCLTOIE        0x0080
+#define UCRXIFG0        0x0001
+#define UCTXIFG0        0x0002
+#define UCSTTIFG        0x0004
+#define UCSTPIFG        0x0008
+#define UCALIFG         0x0010
+#define UCNACKIFG       0x0020
+#define UCBCNTIFG       0x0040
+#define UCCLTOIFG       0x0080
+
+// CRC16
+volatile unsigned char *sim_CRCDIRB_L(void);
+volatile unsigned short *sim_CRCINIRES(void);
+#define CRCDIRB_L       (*sim_CRCDIRB_L())
+#define CRCINIRES       (*sim_CRCINIRES())
+
+// eCOMP0
+extern volatile unsigned short CP0CTL0, CP0CTL1, CP0INT, CP0DACCTL, CP0DACDATA;
+unsigned short sim_CP0IV(void);
+#define CP0IV           sim_CP0IV()
+#define CPPSEL_1        0x0001
+#define CPPEN           0x0010
+#define CPNSEL_6        0x0600
+#define CPNEN           0x1000
+#define CPOUT           0x0001
+#define CPINV           0x0002
+#define CPIES           0x0010
+#define CPFLT           0x0020
+#define CPFLTDLY_0      0x0000
+#define CPFLTDLY_1      0x0040
+#define CPFLTDLY_2      0x0080
+#define CPFLTDLY_3      0x00C0
+#define CPMSEL          0x0100
+#define CPEN            0x0200
+#define CPHSEL_0        0x0000
+#define CPHSEL_1        0x0400
+#define CPHSEL_2        0x0800
+#define CPHSEL_3        0x0C00
+#define CPIFG           0x0001
+#define CPIIFG          0x0002
+#define CPIE            0x0100
+#define CPIIE           0x0200
+#define CPDACBUFS       0x0001
+#define CPDACREFS       0x0002
+#define CPDACSW         0x0040
+#define CPDACEN         0x0080
+
+// Vectors, #pragma vector is ignored on the host, mcu.c calls the ISRs by name
+#define TIMER3_B0_VECTOR        0
+#define TIMER3_B1_VECTOR        0
+#define EUSCI_A1_VECTOR         0
+#define EUSCI_B1_VECTOR         0
+#define ECOMP0_ECOMP1_VECTOR    0
+#define ADC_VECTOR              0
+
+#endif
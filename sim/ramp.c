@@ -0,0 +1,118 @@
+//--------------------------------------------------------------------
+// Ramp_Table and move times of FinalProject9main.c
+//--------------------------------------------------------------------
+// Runs the firmware's rampInit() and dumps Ramp_Table: the period before
+// each step of the ramp in TB3 counts (us at TIMER_HZ), the step rate it
+// gives and the time from rest, up to where the table reaches MIN_PERIOD,
+// and says so if it runs out before then.
+// Then queues moves with startMove() in each step mode and adds up the
+// periods ISR_TB3_CCR0 would load for them, the same choice between the
+// table and the cruise period, from the move being loaded to its last
+// step. Each move is shown next to the time it would take at the cruise
+// period all the way, what the ramp costs.
+//
+//     make ramp
+//--------------------------------------------------------------------
+
+#include <stdio.h>
+
+#define TIMER_HZ 1000000UL                // as in the firmware
+#define RAMP_SIZE 256
+#define MIN_PERIOD 600
+#define MOVE_SIZE 4
+#define STEP_WAVE 0
+#define STEP_HALF 2
+
+// firmware state
+typedef struct {
+    int dir;
+    int delta;
+    int parity;
+    unsigned int steps;
+    unsigned int rampLen;
+    unsigned int cruise;
+} Move;
+extern unsigned int Ramp_Table[RAMP_SIZE];
+extern Move Move_Queue[MOVE_SIZE];
+extern volatile unsigned int moveHead;
+extern volatile unsigned int moveTail;
+extern unsigned int accel;
+extern int fspin;
+extern int rspin;
+extern int frpm;
+extern int rrpm;
+int rampInit(void);
+int startMove(int direction, int steps, unsigned int rpm);
+int setStepMode(int mode);
+
+static const char *Mode_Names[] = {"wave", "full", "half"};
+
+// the step engine's periods for move m, from loading it to its last step
+static unsigned long moveTime(const Move *m){
+    unsigned long total;
+    unsigned int index, left, n;
+
+    if(m->steps == 0){
+        return 0;
+    }
+    total = (m->rampLen > 0) ? Ramp_Table[0] : m->cruise;
+    for(index=1; index<m->steps; index++){
+        left = m->steps - index;
+        n = (index < left) ? index : left-1;
+        total += (n < m->rampLen) ? Ramp_Table[n] : m->cruise;
+    }
+    return total;
+}
+
+static void move(const char *name, int direction, int steps, unsigned int rpm){
+    const Move *m;
+    unsigned long total;
+
+    moveHead = 0;
+    moveTail = 0;
+    if(startMove(direction, steps, rpm) != 0){
+        printf("%-8s refused\n", name);
+        return;
+    }
+    m = &Move_Queue[0];
+    total = moveTime(m);
+    printf("%-8s %5d %4u   %5u %5u %6u   %9.2f %9.2f   %+7.2f\n", name, steps, rpm,
+           m->steps, m->rampLen, m->cruise, total / (TIMER_HZ/1000.0),
+           (double)m->steps * m->cruise / (TIMER_HZ/1000.0),
+           (total - (double)m->steps * m->cruise) / (TIMER_HZ/1000.0));
+}
+
+int main(void){
+    unsigned long elapsed = 0;
+    unsigned int n;
+    int mode;
+
+    rampInit();
+    printf("Ramp_Table, accel %u steps/s^2, TB3 at %lu Hz\n", accel, TIMER_HZ);
+    printf("  n  period us   rate Hz  from rest ms\n");
+    for(n=0; n<RAMP_SIZE; n++){
+        elapsed += Ramp_Table[n];
+        printf("%3u  %9u  %8.1f  %12.3f\n", n, Ramp_Table[n], (double)TIMER_HZ / Ramp_Table[n],
+               elapsed / (TIMER_HZ/1000.0));
+        if(n > 0 && Ramp_Table[n] == Ramp_Table[n-1]){
+            printf("     %u to the end of the table\n", Ramp_Table[n]);
+            break;
+        }
+    }
+    if(Ramp_Table[RAMP_SIZE-1] > MIN_PERIOD){
+        printf("the table runs out at %u us, above MIN_PERIOD %u, a move asking for more\n"
+               "than %.1f steps/s cruises at that\n", Ramp_Table[RAMP_SIZE-1], MIN_PERIOD,
+               (double)TIMER_HZ / Ramp_Table[RAMP_SIZE-1]);
+    }
+
+    for(mode=STEP_WAVE; mode<=STEP_HALF; mode++){
+        setStepMode(mode);
+        printf("\n%s stepping\n", Mode_Names[mode]);
+        printf("move     steps  rpm   engine  ramp cruise     total ms  no ramp ms   ramp ms\n");
+        move("forward", 0, fspin, frpm);
+        move("reverse", 1, rspin, rrpm);
+        move("fast", 0, 2000, 100);
+    }
+    setStepMode(STEP_WAVE);
+    return 0;
+}
@@ -0,0 +1,779 @@
+//--------------------------------------------------------------------
+// Drill press run for the host build of FinalProject9main.c
+//--------------------------------------------------------------------
+// Drives the pressure on P1.1/P1.4, the two switches and the terminal
+// through a session that hits every path: a goto, a forward move into
+// the eCOMP0 trip and the cutoff, a pressure spike, a retract into the
+// soft limit, stacked moves, the RTC time stamp, the pressure alert, a
+// raw capture, the log and the profiler, then dithers the pressure
+// across every zone boundary. The terminal side prints the
+// text with a time stamp and decodes the frames with host/wire.c, the
+// raw line can go to a file for the other host tools. At the end the
+// timing the model measured is reported and checked, the exit code is
+// the number of failed checks.
+//--------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "msp430.h"
+#include "sim.h"
+#include "wire.h"
+
+int fw_main(void);                        // main() of FinalProject9main.c, renamed by the Makefile
+
+// firmware state the checks look at
+extern unsigned int zone;
+extern volatile int tripped;
+extern int stepMode;
+extern int fspin;
+extern int frpm;
+int startMove(int direction, int steps, unsigned int rpm);
+extern volatile unsigned int phase;
+extern volatile long position;
+extern volatile unsigned int i2cErrors;
+extern volatile int i2cState;
+extern int rtcWarn;
+extern volatile unsigned int evDropped;
+extern volatile unsigned int msgDropped;
+extern volatile unsigned int adcOverrun;
+typedef struct {
+    unsigned int type;
+    unsigned int data;
+} Event;
+extern Event Event_Queue[];
+extern volatile unsigned int evHead;
+extern unsigned int Zone_Enter[];
+extern unsigned int Zone_Exit[];
+extern unsigned int AVE_Value;
+typedef struct {
+    unsigned int count0;
+    unsigned int lb0;
+    unsigned int count1;
+    unsigned int lb1;
+} Calibration;
+extern Calibration Cal_Data;
+int calInit(void);
+unsigned int countsToLb(unsigned int counts);
+unsigned int lbToCounts(unsigned int lb);
+
+#define RUN_TIME 13.5                     // seconds
+#define COUNTS_PER_LB 51.2                // 2560 counts at 50 lb
+#define NOISE 3                           // +- counts on the sensor
+#define BAUD 115200
+#define CHAR_TIME (10.0 / BAUD)           // terminal sends back to back
+#define SCL_HZ 400000
+#define TIMER_HZ 1000000                  // what the firmware takes TB3 to count
+#define COILS (BIT0|BIT1|BIT2|BIT3)
+#define EV_SIZE 16
+#define EV_SWITCH 3
+#define ZONE_CUTOFF 3
+
+// Pressure, lb at the end of each straight segment
+static const double Pressure[][2] = {
+    {0.0, 5}, {1.0, 5}, {2.5, 45},        // into unsafe, the RTC stamp
+    {2.6, 45}, {3.1, 55},                 // through 50 lb during the forward move, trip and cutoff
+    {3.6, 55}, {4.0, 20},                 // back down, trip clears
+    {RUN_TIME, 20},
+};
+#define PRESSURE_POINTS (sizeof(Pressure) / sizeof(Pressure[0]))
+#define TRIP_FROM 2.6                     // segment that crosses cutoff
+#define TRIP_TO 3.1
+#define SPIKE_AT 9.0                      // 200 us at 60 lb, trips eCOMP0 but not the zone
+#define SPIKE_TIME 0.0002
+#define SPIKE_LB 60
+#define STACK_AT 6.0                      // two forward presses back to back
+#define FSPIN 51                          // steps in a forward move
+#define POS_MIN -1026                     // posMin, half steps
+#define ARM_AT 1.5                        // capture armed, triggers at 40 lb on the way up
+#define CAP_SIZE 2048
+#define CAP_PRE 512
+#define DITHER_AT 9.6                     // quiet from here, the dither runs to the end
+#define DITHER_SEG 0.6                    // per boundary: a ramp to the level, then the dither
+#define DITHER_RAMP 0.1
+#define DITHER_HZ 5                       // well inside what the median and EMA pass
+#define DITHER_BAND 0.6                   // amplitude, fraction of the hysteresis band
+#define DITHER_SEGS 6                     // up through each enter level, down through each exit level
+#define DITHER_BASE 20                    // lb before and after
+
+// Terminal and switches
+#define ACT_RX 0                          // value: char from the terminal
+#define ACT_SW1 1                         // value: 1 pressed, 0 released
+#define ACT_SW2 2
+#define ACT_RTC_NACK 3                    // value: RTC address phases left unanswered
+#define ACT_RTC_HOLD 4                    // value: ms the RTC holds SCL on the next transfer
+typedef struct {
+    double at;
+    int what;
+    int value;
+} Action;
+#define ACTION_SIZE 256
+static Action Actions[ACTION_SIZE];
+static int actionCount = 0;
+static int actionNext = 0;
+
+// Checks
+static int failures = 0;
+static long endPosition;
+static char Transcript[65536];
+static unsigned int transcriptLen = 0;
+static char Line[256];
+static unsigned int lineLen = 0;
+
+// Frames
+static WireReader Reader;
+static FILE *lineFile = NULL;             // everything on TXD, for the host tools
+static unsigned long Frame_Count[4];
+static unsigned long badFrames = 0;       // right CRC, wrong layout
+static unsigned long logRecords = 0;
+static unsigned int logZone = 0;          // highest zone in the dump
+static WireStatus lastStatus;
+
+// Timing
+static SimStat stepLatency;               // CCR0 match to ISR_TB3_CCR0 entry
+static SimStat tickInterval;              // between 1 ms tick matches
+static unsigned long lateSteps = 0;       // next step deadline already gone by
+static unsigned long ticks = 0;
+static unsigned long long firstTick = 0, lastTick = 0;
+static unsigned long forwardSteps = 0;    // forward steps with the trip or cutoff on
+static unsigned long stackedSteps = 0;    // forward steps of the stacked moves
+static unsigned long long cutoffAt = 0;   // zone first went to cutoff
+static unsigned long long tripEntry = 0;  // ECOMP0_ISR for the ramp trip
+static unsigned long long tripCross = 0;
+static unsigned long spikeCutoffs = 0;
+static int raced = 0;                     // forward move slipped in after the trip
+static unsigned long Switch_Events[3][3]; // [kind][switch], press, release, long press
+static unsigned long framUnlocked = 0;    // main() ran with program FRAM writable
+static unsigned long long nackAt = 0;     // last RTC NACK
+static unsigned long long warnAt = 0;     // uartWarning() got the time
+static int lastWarn = 0;
+static unsigned long lastNacks = 0;
+static unsigned int lastZone = 0;
+static unsigned int Dither_Zones[16];     // zone after each change in the dither
+static unsigned int ditherChanges = 0;
+static unsigned long Dither_Crossings[DITHER_SEGS]; // filtered reading across the level
+static int ditherAbove = -1;
+static unsigned int sessionEnd = 0;       // Transcript up to the dither
+
+// Snapshot at ISR entry
+static unsigned int snapCoils;
+static unsigned int snapPhase;
+static int snapCutoff;
+static int snapTripped;
+static unsigned int snapEvHead;
+static unsigned int snapTick;
+static unsigned int snapStep;
+
+//--------------- Stimulus -------------------------------------------
+
+static void addAction(double at, int what, int value){
+    if(actionCount < ACTION_SIZE){
+        Actions[actionCount].at = at;
+        Actions[actionCount].what = what;
+        Actions[actionCount].value = value;
+        actionCount++;
+    }
+}
+
+static void addText(double at, const char *text){
+    unsigned int n;
+
+    for(n=0; text[n] != 0; n++){
+        addAction(at + n*CHAR_TIME, ACT_RX, (unsigned char)text[n]);
+    }
+}
+
+// a press that bounces for about 1.5 ms each way
+static void addPress(double at, int sw, double hold){
+    static const double Bounce[] = {0, 0.0003, 0.0007, 0.0010, 0.0014};
+    unsigned int n;
+
+    for(n=0; n<5; n++){
+        addAction(at + Bounce[n], sw, (n & 1) == 0);
+    }
+    for(n=0; n<3; n++){
+        addAction(at + hold + Bounce[n], sw, (n & 1) != 0);
+    }
+}
+
+static int actionOrder(const void *a, const void *b){
+    const Action *x = a, *y = b;
+
+    if(x->at != y->at){
+        return (x->at < y->at) ? -1 : 1;
+    }
+    return (x < y) ? -1 : 1;
+}
+
+static void setup(void){
+    addText(0.05, "g-200\r");             // retract 100 steps
+    addPress(0.5, ACT_SW1, 0.04);         // forward at 5 lb, queued behind the goto
+    addText(ARM_AT, "a");
+    addAction(2.31, ACT_RTC_NACK, 2);     // the warning read fails twice, then the retry gets it
+    addText(2.55, "f");                   // about 45 lb
+    addPress(2.7, ACT_SW1, 0.04);         // forward at 46 lb, the trip stops it
+    addPress(3.3, ACT_SW2, 1.2);          // retract a turn at cutoff into posMin, long press
+    addPress(3.4, ACT_SW1, 0.04);         // at cutoff, only the release gets through
+    addText(3.45, "g3000\r");             // at cutoff, has to be refused
+    addPress(5.2, ACT_SW1, 0.04);         // queued behind the retract, the soft limit cancels it
+    addText(5.3, "m");
+    addText(5.45, "h200\r");             // 20 lb, the same line through a new high point
+    addText(5.5, "l600\r");              // 60 lb low point above it, refused
+    addPress(STACK_AT, ACT_SW1, 0.04);    // the second waits for the first, then runs back to back
+    addPress(STACK_AT + 0.2, ACT_SW1, 0.04);
+    addAction(7.05, ACT_RTC_HOLD, 25);    // past I2C_TIMEOUT on the next status read
+    addText(8.5, "e");
+    addText(8.7, "p");
+    addText(8.8, "s2\r");                 // half stepping
+    addText(8.85, "g-825\r");             // 3 half steps back, not rounded to full steps
+    addText(8.9, "s1\r");                 // full stepping from the next move
+    qsort(Actions, actionCount, sizeof(Action), actionOrder);
+}
+
+// boundary k of the dither, 1..3 going up, 3..1 coming down
+static unsigned int ditherZone(int seg){
+    return (seg < DITHER_SEGS/2) ? seg + 1 : DITHER_SEGS - seg;
+}
+
+static double ditherLevel(int seg){
+    unsigned int k = ditherZone(seg);
+
+    if(seg < 0 || seg >= DITHER_SEGS){
+        return DITHER_BASE;
+    }
+    return ((seg < DITHER_SEGS/2) ? Zone_Enter[k] : Zone_Exit[k]) / COUNTS_PER_LB;
+}
+
+// a ramp from the last level to the boundary, then a sine around it that
+// stays inside the hysteresis, so each boundary is really crossed once
+static double ditherLb(double t){
+    int seg = (int)((t - DITHER_AT) / DITHER_SEG);
+    double in = t - DITHER_AT - seg*DITHER_SEG, from = ditherLevel(seg-1);
+    unsigned int k = ditherZone(seg);
+
+    if(in < DITHER_RAMP || seg >= DITHER_SEGS){
+        return from + (ditherLevel(seg) - from) * ((in < DITHER_RAMP) ? in / DITHER_RAMP : 1);
+    }
+    return ditherLevel(seg) + DITHER_BAND * (Zone_Enter[k] - Zone_Exit[k]) / COUNTS_PER_LB *
+           sin(2*3.14159265358979 * DITHER_HZ * (in - DITHER_RAMP));
+}
+
+static double lbAt(double t){
+    unsigned int n;
+
+    if(t >= DITHER_AT){
+        return ditherLb(t);
+    }
+    if(t >= SPIKE_AT && t < SPIKE_AT + SPIKE_TIME){
+        return SPIKE_LB;
+    }
+    for(n=1; n<PRESSURE_POINTS; n++){
+        if(t < Pressure[n][0]){
+            return Pressure[n-1][1] + (Pressure[n][1] - Pressure[n-1][1]) *
+                   (t - Pressure[n-1][0]) / (Pressure[n][0] - Pressure[n-1][0]);
+        }
+    }
+    return Pressure[PRESSURE_POINTS-1][1];
+}
+
+unsigned int scenarioAnalog(unsigned long long at){
+    unsigned long us = (unsigned long)simUs(at);
+    unsigned long hash = us * 2654435761UL;
+    double counts;
+
+    hash ^= hash >> 13;
+    counts = lbAt(us / 1e6) * COUNTS_PER_LB + (int)(hash % (2*NOISE+1)) - NOISE;
+    if(counts < 0){
+        return 0;
+    }
+    return (counts > 4095) ? 4095 : (unsigned int)counts;
+}
+
+unsigned long long scenarioNext(void){
+    return (actionNext < actionCount) ? simCycles(Actions[actionNext].at) : NEVER;
+}
+
+void scenarioStep(void){
+    Action *a;
+
+    while(actionNext < actionCount && simCycles(Actions[actionNext].at) <= simNow){
+        a = &Actions[actionNext++];
+        switch(a->what){
+        case ACT_RX:
+            simUartReceive(a->value);
+            break;
+        case ACT_SW1:
+            P4IN = a->value ? (P4IN & ~BIT1) : (P4IN | BIT1);
+            break;
+        case ACT_SW2:
+            P2IN = a->value ? (P2IN & ~BIT3) : (P2IN | BIT3);
+            break;
+        case ACT_RTC_NACK:
+            simRtcNack = a->value;
+            break;
+        case ACT_RTC_HOLD:
+            simRtcHold = a->value / 1000.0;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+//--------------- Terminal -------------------------------------------
+
+static double now(void){
+    return simUs(simNow) / 1e6;
+}
+
+static void textChar(unsigned char c){
+    if(c == '\n' || c == '\r'){
+        if(lineLen > 0){
+            Line[lineLen] = 0;
+            printf("%9.6f  %s\n", now(), Line);
+            lineLen = 0;
+        }
+    }else if(lineLen < sizeof(Line)-1){
+        Line[lineLen++] = c;
+    }
+    if(transcriptLen < sizeof(Transcript)-1){
+        Transcript[transcriptLen++] = c;
+        Transcript[transcriptLen] = 0;
+    }
+}
+
+// WireLogs, oldest first
+static void logCheck(const unsigned char *payload, unsigned int length){
+    WireLog r;
+    const unsigned char *t = r.time;
+    unsigned int n;
+
+    for(n=0; wireLog(payload, length, n, &r) == 0; n++){
+        logRecords++;
+        if(r.zone > logZone){
+            logZone = r.zone;
+        }
+        printf("%9.6f  [log] seq %u, zone %u, peak %u, %u samples, %02x:%02x:%02x %02x/%02x/%02x\n",
+               now(), r.seq, r.zone, r.peak, r.duration, t[2], t[1], t[0], t[5], t[3], t[6]);
+    }
+    if(length % WIRE_LOG_BYTES != 0){
+        badFrames++;
+    }
+}
+
+// header then the samples
+static void captureCheck(const unsigned char *payload, unsigned int length){
+    WireCapture h;
+    unsigned int n, bad = 0;
+
+    if(wireCapture(payload, length, &h) != 0 || h.count != CAP_SIZE){
+        printf("FAIL: capture frame %u bytes\n", length);
+        failures++;
+        return;
+    }
+    Frame_Count[WIRE_CAPTURE]++;
+    printf("%9.6f  [capture] %u samples, %u before the trigger, level %u, trigger sample %u\n",
+           now(), h.count, h.pre, h.level, wireSample(payload, CAP_PRE));
+    for(n=1; n<h.count; n++){
+        if(wireSample(payload, n) > wireSample(payload, n-1) + 4*NOISE + 8){
+            bad++;                        // samples out of order or lost
+        }
+    }
+    if(h.pre != CAP_PRE || bad != 0 ||
+       wireSample(payload, CAP_PRE) < h.level || wireSample(payload, CAP_PRE-1) >= h.level){
+        printf("FAIL: capture doesn't start at the trigger\n");
+        failures++;
+    }
+}
+
+void scenarioUartTx(unsigned char c){
+    int type = wireByte(&Reader, c);
+
+    if(lineFile != NULL){
+        fputc(c, lineFile);
+    }
+
+    if(type == WIRE_TEXT){
+        textChar(c);
+    }else if(type == WIRE_BAD){
+        printf("%9.6f  [frame %u] CRC error\n", now(), Reader.type);
+    }else if(type == WIRE_STATUS){
+        if(wireStatus(Reader.payload, Reader.length, &lastStatus) == 0){
+            Frame_Count[type]++;
+        }else{
+            badFrames++;
+        }
+    }else if(type == WIRE_LOG){
+        Frame_Count[type]++;
+        logCheck(Reader.payload, Reader.length);
+    }else if(type == WIRE_CAPTURE){
+        captureCheck(Reader.payload, Reader.length);
+    }
+}
+
+//--------------- Timing ---------------------------------------------
+
+// every zone change from the dither on, and the filtered reading
+// against the level it's dithering around
+static void ditherSeen(double t){
+    int seg = (int)((t - DITHER_AT) / DITHER_SEG), above;
+
+    if(t < DITHER_AT){
+        lastZone = zone;
+        return;
+    }
+    if(sessionEnd == 0){
+        sessionEnd = transcriptLen;
+    }
+    if(zone != lastZone){
+        if(ditherChanges < sizeof(Dither_Zones)/sizeof(Dither_Zones[0])){
+            Dither_Zones[ditherChanges] = zone;
+        }
+        ditherChanges++;
+        lastZone = zone;
+    }
+    if(seg < DITHER_SEGS && t - DITHER_AT - seg*DITHER_SEG >= DITHER_RAMP){
+        above = AVE_Value >= ditherLevel(seg) * COUNTS_PER_LB;
+        if(ditherAbove >= 0 && above != ditherAbove){
+            Dither_Crossings[seg]++;
+        }
+        ditherAbove = above;
+    }else{
+        ditherAbove = -1;
+    }
+}
+
+static void cutoffSeen(void){
+    double t = now();
+
+    ditherSeen(t);
+
+    if(zone == ZONE_CUTOFF && cutoffAt == 0){
+        cutoffAt = simNow;
+    }
+    if(zone == ZONE_CUTOFF && t >= SPIKE_AT && t < SPIKE_AT + 0.1){
+        spikeCutoffs++;
+    }
+}
+
+void scenarioMain(void){
+    if(!(SYSCFG0 & PFWP)){
+        framUnlocked++;
+    }
+    if(lastWarn && !rtcWarn && warnAt == 0){
+        warnAt = simNow;
+    }
+    lastWarn = rtcWarn;
+    cutoffSeen();
+}
+
+void scenarioIsr(int source, unsigned long long entry, int done){
+    unsigned int coils = P3OUT & COILS;
+    unsigned int n, kind, forward, d;
+
+    if(!done){
+        snapCoils = coils;
+        snapPhase = phase;
+        snapCutoff = (zone == ZONE_CUTOFF);
+        snapTripped = tripped;
+        snapEvHead = evHead;
+        snapTick = TB3CCR2;
+        snapStep = TB3CCR0;
+        return;
+    }
+
+    for(n=snapEvHead; n!=evHead; n=(n+1) & (EV_SIZE-1)){
+        kind = Event_Queue[n].data >> 4;
+        if(Event_Queue[n].type == EV_SWITCH && kind < 3 && (Event_Queue[n].data & 3) != 0){
+            Switch_Events[kind][(Event_Queue[n].data & 3) - 1]++;
+        }
+    }
+
+    switch(source){
+    case SRC_TB3_0:
+        if(coils != snapCoils){
+            statAdd(&stepLatency, entry - simTimerMatch(3, 0));
+            forward = ((phase - snapPhase) & 7) < 4;    // CW moves up Phase_Table
+            if(forward && (snapCutoff || snapTripped)){
+                forwardSteps++;
+            }
+            if(forward && now() > STACK_AT){
+                stackedSteps++;
+            }
+        }
+        d = (TB3CCR0 - TB3R) & 0xFFFF;
+        if(d > ((TB3CCR0 - snapStep) & 0xFFFF)){
+            lateSteps++;                  // TB3 already went by, it has to wrap before the next step
+        }
+        break;
+    case SRC_TB3_N:
+        if(TB3CCR2 != snapTick){
+            if(ticks == 0){
+                firstTick = simTimerMatch(3, 2);
+            }else{
+                statAdd(&tickInterval, simTimerMatch(3, 2) - lastTick);
+            }
+            lastTick = simTimerMatch(3, 2);
+            ticks++;
+        }
+        if(tripped && zone == ZONE_CUTOFF && !raced){
+            // main was inside startMove() past its check when the trip and
+            // the cutoff cleared the queue, ISR_TB3_CCR0 mustn't load it
+            raced = 1;
+            tripped = 0;
+            zone = 0;
+            startMove(0, fspin, frpm);
+            zone = ZONE_CUTOFF;
+            tripped = 1;
+        }
+        break;
+    case SRC_B1:
+        if(simI2cNacks != lastNacks){
+            lastNacks = simI2cNacks;
+            nackAt = entry;
+        }
+        break;
+    case SRC_COMP:
+        if(tripped && !snapTripped && tripEntry == 0){
+            tripEntry = entry;
+            tripCross = simCompCross;
+            if(coils != 0){
+                printf("FAIL: coils still on after ECOMP0_ISR\n");
+                failures++;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    cutoffSeen();
+}
+
+//--------------- Report ---------------------------------------------
+
+static void check(int ok, const char *what){
+    if(!ok){
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static void expect(const char *text){
+    if(strstr(Transcript, text) == NULL){
+        printf("FAIL: never printed \"%s\"\n", text);
+        failures++;
+    }
+}
+
+static double meanUs(const SimStat *s){
+    return s->count ? simUs(s->sum / s->count) : 0;
+}
+
+// ramp crossing of the cutoff level, no noise
+static double cutoffCross(void){
+    double t;
+
+    for(t=TRIP_FROM; t<TRIP_TO; t+=1e-5){
+        if(lbAt(t) * COUNTS_PER_LB >= Zone_Enter[ZONE_CUTOFF]){
+            return t;
+        }
+    }
+    return TRIP_TO;
+}
+
+// number of times text was printed, from start up to end
+static int printed(const char *text, unsigned int start, unsigned int end){
+    const char *at = &Transcript[start];
+    int n = 0;
+
+    while((at = strstr(at, text)) != NULL && at < &Transcript[end]){
+        at++;
+        n++;
+    }
+    return n;
+}
+
+// countsToLb() for every count against the exact line through Cal_Data,
+// and lbToCounts() back, for the default line and one with an offset
+static void calCheck(void){
+    static const Calibration Lines[2] = {{0, 0, 2560, 50*256}, {215, 3*256 + 77, 3890, 92*256 + 13}};
+    const Calibration *c;
+    double exact, err, worst = 0, worstBack = 0;
+    unsigned int n, counts, lb, worstAt = 0;
+
+    for(n=0; n<2; n++){
+        c = &Lines[n];
+        Cal_Data = *c;
+        calInit();
+        for(counts=0; counts<4096; counts++){
+            exact = c->lb0 + ((double)counts - c->count0) * (c->lb1 - c->lb0) / (c->count1 - c->count0);
+            exact = (exact < 0) ? 0 : exact;
+            lb = countsToLb(counts);
+            err = (lb > exact) ? lb - exact : exact - lb;
+            if(err > worst){
+                worst = err;
+                worstAt = counts;
+            }
+            exact = c->count0 + ((double)lb - c->lb0) * (c->count1 - c->count0) / (c->lb1 - c->lb0);
+            if(exact >= 0 && exact <= 4095){
+                err = lbToCounts(lb) - exact;
+                err = (err < 0) ? -err : err;
+                worstBack = (err > worstBack) ? err : worstBack;
+            }
+        }
+    }
+    Cal_Data = Lines[0];
+    calInit();
+    printf("conversion        %.4f lb worst (at %u counts), %.2f counts back, counts 0..4095\n",
+           worst / 256, worstAt, worstBack);
+    // truncated Q12 gain and the shift, under 2 Q8 steps; lbToCounts() rounds
+    check(worst < 2, "countsToLb() off the calibration line");
+    check(worstBack <= 0.5, "lbToCounts() not the nearest count");
+}
+
+static void report(void){
+    unsigned long timerHz = simMclkHz() / simTimerDiv(3);
+    unsigned long long tickCycles = (unsigned long long)simTimerDiv(3) * (TIMER_HZ/1000);
+    double adcPath = 0;
+    long drift = 0;
+    int n, ditherOk;
+
+    printf("\n---- timing, MCLK %lu Hz ----\n", simMclkHz());
+    printf("source     latency us mean/max    ISR us mean/max    count\n");
+    for(n=0; n<SRC_COUNT; n++){
+        printf("%s   %8.2f %8.2f   %8.2f %8.2f   %6lu\n", Sim_Source_Names[n],
+               meanUs(&simLatency[n]), simUs(simLatency[n].max),
+               meanUs(&simIsrTime[n]), simUs(simIsrTime[n].max), simLatency[n].count);
+    }
+    if(ticks > 0){
+        drift = (long)((lastTick - firstTick) / tickCycles + 1) - (long)ticks;
+    }
+    printf("step latency      %.2f us mean, %.2f us max, %lu steps, %lu late\n",
+           meanUs(&stepLatency), simUs(stepLatency.max), stepLatency.count, lateSteps);
+    printf("tick              %lu ticks, interval %.3f..%.3f us, drift %ld ticks\n",
+           ticks, simUs(tickInterval.min), simUs(tickInterval.max), drift);
+    printf("ADC interval      %.3f..%.3f us, %lu conversions, %lu missed, %lu ignored, %lu overruns\n",
+           simUs(simAdcInterval.min), simUs(simAdcInterval.max), simAdcInterval.count,
+           simAdcMissed, simAdcHeld, simAdcOverruns);
+    printf("UART              %.1f baud (%+.3f%%), %lu bytes, %lu overruns\n",
+           simUartBaud(), (simUartBaud() / BAUD - 1) * 100, simUartBytes, simUartOverruns);
+    printf("I2C               %.1f Hz (%+.3f%%), %lu transfers %.1f..%.1f us, %lu NACKs\n",
+           simI2cHz(), (simI2cHz() / SCL_HZ - 1) * 100, simI2cTime.count,
+           simUs(simI2cTime.min), simUs(simI2cTime.max), simI2cNacks);
+    printf("TB3               %lu Hz (%+ld ppm from TIMER_HZ)\n", timerHz,
+           (long)(((double)timerHz / TIMER_HZ - 1) * 1e6));
+    if(tripEntry != 0){
+        printf("trip              %.2f us from the crossing to ECOMP0_ISR\n",
+               simUs(tripEntry - tripCross));
+    }
+    if(nackAt != 0 && warnAt > nackAt){
+        printf("RTC retry         %.2f ms from the last NACK to the warning\n",
+               simUs(warnAt - nackAt) / 1e3);
+    }
+    if(cutoffAt != 0){
+        adcPath = simUs(cutoffAt) / 1e6 - cutoffCross();
+        printf("cutoff            %.2f ms from the crossing to adcStatus()\n", adcPath * 1e3);
+    }
+    printf("dither            zones");
+    for(n=0; n<(int)ditherChanges && n<16; n++){
+        printf(" %u", Dither_Zones[n]);
+    }
+    printf(", filtered reading across the level");
+    for(n=0; n<DITHER_SEGS; n++){
+        printf(" %lu", Dither_Crossings[n]);
+    }
+    printf(" times\n");
+    printf("switches          SW1 %lu/%lu/%lu, SW2 %lu/%lu/%lu press/release/long\n",
+           Switch_Events[0][0], Switch_Events[1][0], Switch_Events[2][0],
+           Switch_Events[0][1], Switch_Events[1][1], Switch_Events[2][1]);
+    printf("position          %ld half steps at the end\n", endPosition);
+    printf("frames            %lu status, %lu log, %lu capture, %lu CRC errors, %lu bad layout\n",
+           Frame_Count[WIRE_STATUS], Frame_Count[WIRE_LOG], Frame_Count[WIRE_CAPTURE],
+           Reader.crcErrors, badFrames);
+    printf("firmware          i2cErrors %u, evDropped %u, msgDropped %u, adcOverrun %u\n\n",
+           i2cErrors, evDropped, msgDropped, adcOverrun);
+
+    expect("Motor moved forward");
+    expect("Motor reversed");
+    expect("unsafe conditions at 12:14:0");
+    expect("on 12/06/24");
+    expect("Force  4");
+    expect("min   max  mean");
+    expect("1 queued");
+    expect("Soft limit reached");
+    check(printed("Pressure trip!", 0, sessionEnd) == 2, "ramp and spike not one trip each");
+    check(printed("Alert! Alert!", 0, sessionEnd) == 2, "goto at cutoff not refused with the alert");
+    check(stepLatency.count > 0 && simUs(stepLatency.max) < 50, "step latency over 50 us");
+    check(lateSteps == 0, "step deadline missed");
+    check(ticks > 0 && drift == 0 && tickInterval.min == tickCycles && tickInterval.max == tickCycles,
+          "tick drifted");
+    check(simAdcInterval.min == simAdcInterval.max, "sample clock jitters with the motor");
+    check(tripEntry != 0 && simUs(tripEntry - tripCross) < 10, "eCOMP0 trip slower than 10 us");
+    check(cutoffAt != 0 && adcPath < 0.040, "ADC path to cutoff slower than 40 ms");
+    check(spikeCutoffs == 0, "the spike put the zone in cutoff");
+    check(simAdcOverruns == 0 && simAdcMissed == 0 && adcOverrun == 0, "ADC overrun");
+    check(simAdcHeld == 0 && simAdcInterval.count > 1000*(RUN_TIME-1), "ADC ignores the sample clock");
+    check(forwardSteps == 0, "forward step with the trip or cutoff on");
+    check(stackedSteps == 2*FSPIN, "stacked moves not run in full");
+    check(endPosition == POS_MIN + 2*2*FSPIN - 3, "position lost steps");
+    check(Switch_Events[0][0] == 5 && Switch_Events[1][0] == 6 && Switch_Events[2][0] == 0,
+          "SW1 bounced presses not one event each");
+    check(Switch_Events[0][1] == 1 && Switch_Events[1][1] == 1 && Switch_Events[2][1] == 1,
+          "SW2 long press not press, long press and release");
+    check(simI2cTime.count >= Frame_Count[WIRE_STATUS], "RTC not read for each status frame");
+    // two NACKs on the warning read, the held SCL times the status read out
+    check(simI2cNacks == 2 && i2cErrors == 3, "I2C errors not counted");
+    check(nackAt != 0 && warnAt > nackAt && simUs(warnAt - nackAt) < 5000,
+          "warning read not retried after the NACK");
+    check(i2cState == 0, "I2C not back to idle");
+    check(simI2cHz() > 0.99*SCL_HZ && simI2cHz() < 1.01*SCL_HZ, "SCL not at 400 kHz");
+    check(evDropped == 0, "events dropped");
+    check(msgDropped == 0, "UART messages dropped");
+    check(simUartOverruns == 0, "UART receive overrun");
+    // 10 a second, less the ones skipped while the capture is going out
+    check(Frame_Count[WIRE_STATUS] >= 5*RUN_TIME, "status frames missing");
+    check(lastStatus.position == endPosition && lastStatus.dir == 3, "last status frame stale");
+    check(Frame_Count[WIRE_CAPTURE] == 1, "no capture");
+    check(Reader.crcErrors == 0, "frame CRC errors");
+    check(badFrames == 0, "frame payload not the documented layout");
+    check(logRecords == 1 && logZone == ZONE_CUTOFF, "log doesn't hold the one cutoff");
+    check(stepMode == 1, "s1 didn't select full stepping");
+    expect("Calibration point rejected");
+    check(Cal_Data.count0 == 0 && Cal_Data.lb0 == 0 && Cal_Data.lb1 == 20*256 &&
+          Cal_Data.count1 > 1000 && Cal_Data.count1 < 1050, "refused calibration point changed the stored line");
+    calCheck();
+    // one zoneEnter() per boundary however often the reading crosses it
+    ditherOk = ditherChanges == DITHER_SEGS &&
+               printed("Alert! Alert!", sessionEnd, transcriptLen) == 1;
+    for(n=0; n<DITHER_SEGS; n++){
+        ditherOk = ditherOk && Dither_Zones[n] == ((n < DITHER_SEGS/2) ? ditherZone(n) : ditherZone(n) - 1u) &&
+                   Dither_Crossings[n] >= 3;
+    }
+    check(ditherOk, "dither not one zone change per boundary");
+    check(framUnlocked == 0, "main() ran with program FRAM unlocked");
+}
+
+// drillsim [file], the file gets the bytes the firmware sent on TXD
+int main(int argc, char **argv){
+    setup();
+    wireInit(&Reader);
+    if(argc > 1 && (lineFile = fopen(argv[1], "wb")) == NULL){
+        printf("FAIL: can't write %s\n", argv[1]);
+        return 1;
+    }
+    if(simRun(fw_main, RUN_TIME) != 0){
+        printf("FAIL: main() returned\n");
+        return 1;
+    }
+    if(lineFile != NULL){
+        fclose(lineFile);
+    }
+    endPosition = position;
+    if(lineLen > 0){
+        textChar('\n');
+    }
+    report();
+    printf("%s, %d failed\n", failures ? "FAIL" : "PASS", failures);
+    return failures;
+}
@@ -0,0 +1,225 @@
+//--------------------------------------------------------------------
+// TB3 deadlines of FinalProject9main.c over a long run
+//--------------------------------------------------------------------
+// Runs only the scheduler on the FR2355 model: clockInit(), TB3 set up
+// the way init() does it, ISR_TB3_CCR0 stepping and ISR_TB3_CCRn's 1 ms
+// tick, with main() doing nothing but taking events. No ADC, UART or I2C,
+// so a run of many million ticks takes seconds. scenarioMain() keeps the
+// move queue fed with moves of any length, speed and step mode, back
+// and forth inside the soft limits, so CCR0 goes through ramps, cruises
+// and the stopped poll while CCR2 ticks on beside it, and TB3R wraps
+// every 65.5 ms all the way through.
+// Each deadline is checked against where it should be from the first
+// one and the periods loaded since:
+//   tick      first match + n * TICK_PERIOD, every one of them
+//   step      first match + every period ISR_TB3_CCR0 added to TB3CCR0
+// in MCLK cycles, so a deadline set from the ISR's entry time instead of
+// the last one, or a count lost at a wrap, shows up as drift.
+// The exit code is the number of failed checks.
+//
+//     sched [seconds]                  virtual time, SCHED_TIME if none
+//--------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "msp430.h"
+#include "sim.h"
+
+#define SCHED_TIME 4000.0                 // s, four million ticks
+#define TICK_PERIOD 1000                  // TB3 counts, as in the firmware
+#define CLK_TBIDEX TBIDEX_2               // /8 /3 at MCLK_MHZ 24, as in the firmware
+#define MOVE_STEPS 3000                   // longest move queued
+#define REST_TIME 2.0                     // longest stop, the queue left to run dry
+#define STEP_HALF 2
+
+// firmware state
+typedef struct {
+    unsigned int type;
+    unsigned int data;
+} Event;
+extern unsigned int Ramp_Table[];
+extern volatile int stepsLeft;
+extern volatile long position;
+extern volatile int dir;
+extern long posMin;
+extern long posMax;
+int clockInit(void);
+int rampInit(void);
+int startMove(int direction, int steps, unsigned int rpm);
+int setStepMode(int mode);
+unsigned int moveQueued(void);
+int getEvent(Event *ev);
+
+static unsigned long seed = 1;
+static unsigned long moves = 0;
+static unsigned long long restUntil = 0;
+static unsigned long ticks = 0;
+static unsigned long long firstTick = 0;
+static long long tickDrift = 0;           // cycles, the worst seen
+static unsigned long tickOff = 0;         // ticks off their place
+static unsigned long steps = 0;           // ISR_TB3_CCR0 runs, steps and polls
+static unsigned long long firstStep = 0;
+static unsigned long long stepCounts = 0; // TB3 counts added to TB3CCR0 since the first
+static unsigned long long stepLast = 0;   // stepCounts at the last one
+static unsigned int stepBefore;           // TB3CCR0 on entry
+static long long stepDrift = 0;
+static unsigned long stepOff = 0;
+static unsigned long stepsMoved = 0;
+static long lastPosition = 0;
+static int failures = 0;
+
+static void check(int ok, const char *what){
+    if(!ok){
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static unsigned int pick(unsigned int range){
+    seed = seed * 1103515245UL + 12345;
+    return (seed >> 16) % range;
+}
+
+static long long worse(long long worst, long long off){
+    if(off < 0){
+        off = -off;
+    }
+    return (off > worst) ? off : worst;
+}
+
+//--------------- Firmware -------------------------------------------
+
+// init() with only the clock and the TB3 deadlines
+static int schedMain(void){
+    Event ev;
+
+    WDTCTL = WDTPW | WDTHOLD;
+    clockInit();
+    TB3CTL |= TBCLR;
+    TB3CTL |= TBSSEL__SMCLK;
+    TB3CTL |= ID__8;
+    TB3EX0 = CLK_TBIDEX;
+    TB3CTL |= MC__CONTINUOUS;
+
+    rampInit();
+    TB3CCR0 = Ramp_Table[0];
+    TB3CCTL0 &= ~CCIFG;
+    TB3CCTL0 |= CCIE;
+    TB3CCR2 = TICK_PERIOD;
+    TB3CCTL2 &= ~CCIFG;
+    TB3CCTL2 |= CCIE;
+    __enable_interrupt();
+    PM5CTL0 &= ~LOCKLPM5;
+
+    for(;;){
+        while(getEvent(&ev) == 0);
+        __bis_SR_register(LPM0_bits | GIE);
+    }
+    return 0;
+}
+
+//--------------- Scenario -------------------------------------------
+
+unsigned int scenarioAnalog(unsigned long long at){
+    (void)at;
+    return 0;
+}
+
+unsigned long long scenarioNext(void){
+    return NEVER;
+}
+
+void scenarioStep(void){
+}
+
+void scenarioUartTx(unsigned char c){
+    (void)c;
+}
+
+// keeps two moves queued, towards the middle of the travel, and now
+// and then lets the queue run dry for a while
+void scenarioMain(void){
+    int back;
+
+    while(moveQueued() < 2 && simNow >= restUntil){
+        if(pick(16) == 0){
+            restUntil = simNow + simCycles(pick(1000) * REST_TIME / 1000);
+            break;
+        }
+        if(pick(8) == 0){
+            setStepMode(pick(STEP_HALF+1));
+        }
+        back = position > (posMin + posMax) / 2;
+        if(startMove(back, 1 + pick(MOVE_STEPS), 5 + pick(120)) != 0){
+            break;
+        }
+        moves++;
+    }
+}
+
+void scenarioIsr(int source, unsigned long long entry, int done){
+    unsigned long long count = simTimerDiv(3), match;
+
+    (void)entry;
+    if(source == SRC_TB3_N && !done && (TB3CCTL2 & CCIFG)){
+        match = simTimerMatch(3, 2);
+        if(ticks == 0){
+            firstTick = match;
+        }
+        if(match != firstTick + (unsigned long long)ticks * TICK_PERIOD * count){
+            tickOff++;
+            tickDrift = worse(tickDrift, (long long)(match - firstTick) -
+                              (long long)ticks * TICK_PERIOD * count);
+        }
+        ticks++;
+    }
+    if(source == SRC_TB3_0){
+        if(!done){
+            match = simTimerMatch(3, 0);
+            if(steps == 0){
+                firstStep = match;
+            }
+            if(match != firstStep + stepCounts * count){
+                stepOff++;
+                stepDrift = worse(stepDrift, (long long)(match - firstStep) - (long long)(stepCounts * count));
+            }
+            stepLast = stepCounts;
+            stepBefore = TB3CCR0;
+            lastPosition = position;
+            steps++;
+        }else{
+            stepCounts += (TB3CCR0 - stepBefore) & 0xFFFF;
+            stepsMoved += position != lastPosition;
+        }
+    }
+}
+
+int main(int argc, char **argv){
+    double seconds = (argc > 1) ? atof(argv[1]) : SCHED_TIME;
+    unsigned long long count;
+
+    if(simRun(schedMain, seconds) != 0){
+        printf("FAIL: main() returned\n");
+        return 1;
+    }
+    count = simTimerDiv(3);
+    printf("run               %.0f s at %.0f MHz, TB3 at %.0f Hz, TB3R wrapped %llu times\n",
+           seconds, simMclkHz() / 1e6, (double)simMclkHz() / count,
+           simNow / count / 65536);
+    printf("tick              %lu ticks, %lu off their place, worst %lld cycles\n",
+           ticks, tickOff, tickDrift);
+    printf("step              %lu ISR_TB3_CCR0 runs, %lu steps over %lu moves and %lu stopped polls,\n"
+           "                  %lu off, worst %lld cycles\n", steps, stepsMoved, moves, steps - stepsMoved,
+           stepOff, stepDrift);
+    printf("                  %.3f s of periods loaded against %.3f s from the first deadline\n",
+           simUs(stepLast * count) / 1e6, simUs(simTimerMatch(3, 0) - firstStep) / 1e6);
+    printf("latency           TB3 CCR0 %.1f us max, TB3 CCRn %.1f us max\n",
+           simUs(simLatency[SRC_TB3_0].max), simUs(simLatency[SRC_TB3_N].max));
+    check(ticks + 1 >= (unsigned long)(seconds * simMclkHz() / count / TICK_PERIOD), "ticks missing");
+    check(tickOff == 0, "tick drifted");
+    check(stepOff == 0, "step deadlines drifted");
+    check(stepsMoved > ticks / 10 && moves > seconds / 10 && steps > stepsMoved,
+          "too little stepping to mean anything");
+    printf("%s, %d failed\n", failures ? "FAIL" : "PASS", failures);
+    return failures;
+}
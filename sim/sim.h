@@ -0,0 +1,63 @@
+//--------------------------------------------------------------------
+// sim.h, between the FR2355 model (mcu.c) and the test run (scenario.c)
+//--------------------------------------------------------------------
+
+#ifndef SIM_H
+#define SIM_H
+
+#define NEVER (~0ULL)
+
+// Interrupt sources, highest priority first as on the FR2355
+#define SRC_TB3_0 0                       // ISR_TB3_CCR0
+#define SRC_TB3_N 1                       // ISR_TB3_CCRn
+#define SRC_A1 2                          // ISR_EUSCI_A1
+#define SRC_B1 3                          // EUSCI_B1_I2C_ISR
+#define SRC_ADC 4                         // ADC_ISR
+#define SRC_COMP 5                        // ECOMP0_ISR
+#define SRC_COUNT 6
+
+// min, max and sum of a measurement in MCLK cycles
+typedef struct {
+    unsigned long count;
+    unsigned long long min;
+    unsigned long long max;
+    unsigned long long sum;
+} SimStat;
+
+// Model
+extern unsigned long long simNow;         // MCLK cycles since reset
+extern const char *const Sim_Source_Names[SRC_COUNT];
+extern SimStat simLatency[SRC_COUNT];     // flag up to first ISR instruction
+extern SimStat simIsrTime[SRC_COUNT];     // ISR entry to RETI done
+extern SimStat simAdcInterval;            // between conversion starts
+extern SimStat simI2cTime;                // START to STOP
+extern unsigned long simAdcOverruns;      // ADCMEM0 overwritten before it was read
+extern unsigned long simAdcMissed;        // triggers while a conversion ran
+extern unsigned long simAdcHeld;          // triggers a single conversion mode ignored
+extern unsigned long simUartOverruns;     // RXBUF overwritten before it was read
+extern unsigned long simUartBytes;        // bytes out on TXD
+extern unsigned long simI2cNacks;
+extern unsigned int simRtcNack;           // RTC address phases left unanswered, counts down
+extern double simRtcHold;                 // s the RTC holds SCL low after its next address
+extern unsigned long long simCompCross;   // last time P1.1 went over the DAC level
+
+unsigned long simMclkHz(void);
+double simUs(unsigned long long cycles);
+unsigned long long simCycles(double seconds);
+unsigned int simTimerDiv(int timer);
+unsigned long long simTimerMatch(int timer, int channel);
+double simUartBaud(void);
+double simI2cHz(void);
+void statAdd(SimStat *stat, unsigned long long value);
+int simRun(int (*firmware)(void), double seconds);
+void simUartReceive(unsigned char c);
+
+// Scenario, called by the model
+unsigned int scenarioAnalog(unsigned long long at);      // P1.1/P1.4 in ADC counts
+unsigned long long scenarioNext(void);                    // next stimulus, NEVER for none
+void scenarioStep(void);                                  // apply what's due at simNow
+void scenarioUartTx(unsigned char c);                     // a byte finished on TXD
+void scenarioIsr(int source, unsigned long long entry, int done);
+void scenarioMain(void);                                  // main() is about to run on
+
+#endif
@@ -0,0 +1,356 @@
+//--------------------------------------------------------------------
+// UART queue of FinalProject9main.c, uartSend() to the last stop bit
+//--------------------------------------------------------------------
+// Runs the firmware on the FR2355 model with a retract going so the step
+// ISR competes with ISR_EUSCI_A1. On top of the firmware's own status
+// frames, main() makes bursts of uartSend() calls from scenarioMain(),
+// each message its own buffer: one on an idle line, a few, more than the
+// queue takes, more while it's still full, then a full queue of
+// TEXT_MAX byte messages. Every message that goes into Msg_Queue is noted
+// with its bytes, the time and the bytes still ahead of it on the line.
+// Checks:
+//   order     TXD is every message taken, whole and in order, nothing else
+//   drops     uartSend() refuses exactly when uartRoom() is 0 and
+//             msgDropped counts each one, uartQueued() finds the buffers
+//             taken and not the ones refused
+//   line      no idle time on TXD after a byte whose next one was queued
+//             a frame before
+//   latency   a burst message's last stop bit within the bytes ahead of
+//             it and its own at the line rate, plus one frame for the ISR
+// Then reports the burst latency, the worst against the bound for a full
+// queue, ISR_EUSCI_A1 on the model, and ns on this host for uartSend()
+// and for ISR_EUSCI_A1 a byte with the registers driven by hand.
+// The exit code is the number of failed checks.
+//
+//     make uart
+//--------------------------------------------------------------------
+
+#include <stdio.h>
+#include <time.h>
+#include "msp430.h"
+#include "sim.h"
+
+#define RUN_TIME 1.6
+#define CHAR_TIME (10.0 / 115200)         // one char at the terminal
+#define MSG_SIZE 16                       // as in the firmware
+#define TEXTS 64                          // buffers for the bursts
+#define TEXT_MAX 64
+#define NOTE_MAX 4096
+#define EXPECT_MAX 262144
+#define TIMED 1000000UL
+
+typedef struct {
+    double at;
+    unsigned int count;
+    unsigned int length;                  // 0 for a mix of lengths
+} Burst;
+
+static const Burst Bursts[] = {
+    {0.30, 1, 40},                        // idle line
+    {0.40, 8, 0},
+    {0.60, 20, 0},                        // more than the queue takes
+    {0.602, 4, 0},                        // while it's still full
+    {1.00, MSG_SIZE-1, TEXT_MAX},         // a full queue, from empty
+};
+#define BURSTS (sizeof(Bursts) / sizeof(Bursts[0]))
+
+// a message noted going into Msg_Queue
+typedef struct {
+    unsigned long start;                  // first byte in Expected
+    unsigned int length;
+    unsigned long ahead;                  // bytes in front of it not out yet
+    unsigned long long at;
+    unsigned long long done;              // last stop bit
+    int burst;                            // -1 for the firmware's own
+} Note;
+
+// firmware state
+typedef struct {
+    const char *data;
+    unsigned int length;
+} Message;
+extern Message Msg_Queue[MSG_SIZE];
+extern volatile unsigned int msgHead;
+extern volatile unsigned int msgTail;
+extern volatile unsigned int msgSent;
+extern volatile unsigned int msgDropped;
+int fw_main(void);
+int uartSend(const char *data, unsigned int length);
+int uartQueued(const char *data);
+int uartRoom(void);
+void ISR_EUSCI_A1(void);
+
+static char Text[TEXTS][TEXT_MAX];
+static unsigned int textNext = 0;
+static unsigned int burstNext = 0;
+static Note Notes[NOTE_MAX];
+static unsigned int noteCount = 0;
+static unsigned int noteDone = 0;         // first one not out yet
+static unsigned char Expected[EXPECT_MAX];
+static unsigned long expectLen = 0;
+static unsigned long wire = 0;            // bytes out on TXD
+static unsigned long wrong = 0;           // bytes other than Expected
+static unsigned int seenHead = 0;
+static unsigned long long lastByte = 0;
+static unsigned long gaps = 0;
+static unsigned long busyBytes = 0;       // bytes the line check looked at
+static unsigned long Burst_Taken[BURSTS];
+static int failures = 0;
+
+static void check(int ok, const char *what){
+    if(!ok){
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static unsigned long long frame(void){
+    return simCycles(10.0 / simUartBaud());
+}
+
+static double ms(unsigned long long cycles){
+    return simUs(cycles) / 1000;
+}
+
+//--------------- Stimulus -------------------------------------------
+
+static const char Retract[] = "g-4000\r";   // two turns back, steps all run
+static unsigned int retractSent = 0;
+
+unsigned int scenarioAnalog(unsigned long long at){
+    (void)at;
+    return 256;                           // 5 lb, zone 0
+}
+
+unsigned long long scenarioNext(void){
+    return (retractSent < sizeof(Retract)-1) ? simCycles(0.05 + retractSent*CHAR_TIME) : NEVER;
+}
+
+void scenarioStep(void){
+    while(retractSent < sizeof(Retract)-1 && simCycles(0.05 + retractSent*CHAR_TIME) <= simNow){
+        simUartReceive(Retract[retractSent++]);
+    }
+}
+
+//--------------- Queue ----------------------------------------------
+
+// notes whatever went into Msg_Queue since the last look
+static void queueSeen(int burst){
+    Note *m;
+    unsigned int n;
+
+    while(seenHead != msgHead){
+        if(noteCount < NOTE_MAX && expectLen + Msg_Queue[seenHead].length <= EXPECT_MAX){
+            m = &Notes[noteCount++];
+            m->start = expectLen;
+            m->length = Msg_Queue[seenHead].length;
+            m->ahead = expectLen - wire;
+            m->at = simNow;
+            m->done = 0;
+            m->burst = burst;
+            for(n=0; n<m->length; n++){
+                Expected[expectLen++] = Msg_Queue[seenHead].data[n];
+            }
+        }
+        seenHead = (seenHead+1) & (MSG_SIZE-1);
+    }
+}
+
+// a message for the burst, its own buffer and length
+static unsigned int textFill(const Burst *b, unsigned int k, char **text){
+    unsigned int n, length = b->length ? b->length : 8 + (k*23) % (TEXT_MAX-7);
+
+    *text = Text[textNext % TEXTS];
+    for(n=0; n<length; n++){
+        (*text)[n] = 'A' + (textNext + n) % 26;
+    }
+    textNext++;
+    return length;
+}
+
+static void burst(unsigned int b){
+    char *text[32];
+    int taken[32];
+    unsigned int k, length, room, lost;
+
+    for(k=0; k<Bursts[b].count; k++){
+        length = textFill(&Bursts[b], k, &text[k]);
+        room = uartRoom();
+        lost = msgDropped;
+        taken[k] = (uartSend(text[k], length) == 0);
+        check(taken[k] == (room > 0), "uartSend() refused with room, or took one without");
+        check(msgDropped - lost == (unsigned int)!taken[k], "msgDropped isn't the refusals");
+        queueSeen(b);
+        Burst_Taken[b] += taken[k];
+    }
+    for(k=0; k<Bursts[b].count; k++){
+        check(uartQueued(text[k]) == taken[k], "uartQueued() wrong about a burst buffer");
+    }
+}
+
+void scenarioMain(void){
+    queueSeen(-1);
+    if(burstNext < BURSTS && simCycles(Bursts[burstNext].at) <= simNow){
+        burst(burstNext++);
+    }
+}
+
+void scenarioIsr(int source, unsigned long long entry, int done){
+    (void)entry;
+    if(source == SRC_A1 && !done){
+        queueSeen(-1);                    // main() may not have reached an intrinsic since
+    }
+}
+
+//--------------- Line -----------------------------------------------
+
+void scenarioUartTx(unsigned char c){
+    unsigned long long f = frame();
+    Note *m;
+
+    if(wire >= expectLen || c != Expected[wire]){
+        if(wrong++ == 0){
+            printf("byte %lu on TXD at %.3f ms isn't the one queued\n", wire, ms(simNow));
+        }
+    }
+    // the byte after the last one had a whole frame to get into TXBUF
+    if(wire > 0 && noteDone < noteCount){
+        m = &Notes[noteDone];
+        if(m->at + f <= lastByte){
+            busyBytes++;
+            if(simNow - lastByte > f + f/100){
+                gaps++;
+            }
+        }
+    }
+    wire++;
+    lastByte = simNow;
+    while(noteDone < noteCount && wire >= Notes[noteDone].start + Notes[noteDone].length){
+        Notes[noteDone++].done = simNow;
+    }
+}
+
+//--------------- Host timing ----------------------------------------
+
+static double seconds(void){
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// uartSend() into an empty queue up to full, then emptied by hand
+static double sendNs(void){
+    unsigned long n;
+    double start;
+
+    msgHead = msgTail = msgSent = 0;
+    start = seconds();
+    for(n=0; n<TIMED; n++){
+        if(uartSend(Text[n % TEXTS], TEXT_MAX) != 0){
+            msgTail = msgHead;
+        }
+    }
+    return (seconds() - start) * 1e9 / TIMED;
+}
+
+// a full queue sent a byte at a time, TXIFG set by hand for each
+static double drainNs(unsigned long *bytes){
+    unsigned long n, calls = 0;
+    double start, total = 0;
+
+    for(n=0; n<TIMED / (TEXT_MAX*(MSG_SIZE-1)); n++){
+        msgHead = msgTail = msgSent = 0;
+        while(uartSend(Text[calls % TEXTS], TEXT_MAX) == 0);
+        start = seconds();
+        while(msgTail != msgHead){
+            UCA1IFG |= UCTXIFG;
+            ISR_EUSCI_A1();
+            calls++;
+        }
+        total += seconds() - start;
+    }
+    *bytes = calls;
+    return total * 1e9 / calls;
+}
+
+//--------------- Report ---------------------------------------------
+
+static void report(void){
+    unsigned long long f = frame(), worst = 0, bound;
+    unsigned long late = 0, early = 0, mine = 0, bytes, worstAhead = 0;
+    unsigned int n, b;
+    const Note *m;
+    double sendTime, drainTime;
+
+    printf("line              %.0f baud, %.2f us a frame, %lu bytes out, %lu queued, %lu messages\n",
+           simUartBaud(), simUs(f), wire, expectLen, (unsigned long)noteCount);
+    check(noteCount < NOTE_MAX && expectLen < EXPECT_MAX, "ran out of room for the notes");
+    check(wrong == 0, "TXD isn't the messages taken, in order");
+    check(wire == expectLen, "messages taken and never sent");
+
+    printf("bursts            at s  sent  taken\n");
+    for(b=0; b<BURSTS; b++){
+        printf("                  %5.3f %5u  %5lu\n", Bursts[b].at, Bursts[b].count, Burst_Taken[b]);
+    }
+    check(Burst_Taken[2] < Bursts[2].count && Burst_Taken[3] < Bursts[3].count,
+          "the queue never filled");
+    check(Burst_Taken[4] == MSG_SIZE-1, "an empty queue didn't take MSG_SIZE-1");
+
+    printf("latency           uartSend() to the last stop bit, burst messages\n");
+    printf("                  at ms     bytes  ahead   ms    line ms\n");
+    for(n=0; n<noteCount; n++){
+        m = &Notes[n];
+        if(m->burst < 0 || m->done == 0){
+            continue;
+        }
+        mine++;
+        bound = (m->ahead + m->length) * f;
+        if(m->done - m->at > bound + f){
+            late++;
+        }
+        if(m->done - m->at < m->length * f){
+            early++;
+        }
+        if(m->done - m->at > worst){
+            worst = m->done - m->at;
+            worstAhead = m->ahead;
+        }
+        if(n+1 == noteCount || Notes[n+1].burst != m->burst){
+            printf("                  %8.3f  %5u  %5lu  %6.2f  %6.2f\n", ms(m->at), m->length,
+                   m->ahead, ms(m->done - m->at), ms(bound));
+        }
+    }
+    check(mine > 0 && late == 0, "a message waited longer than the bytes ahead of it");
+    check(early == 0, "a message out faster than the line");
+    printf("                  (last of each burst)\n");
+    printf("worst             %.2f ms with %lu bytes ahead; a full queue of %d byte messages is %.2f ms\n",
+           ms(worst), worstAhead, TEXT_MAX, ms((unsigned long long)(MSG_SIZE-1) * TEXT_MAX * f));
+    printf("                  a message waits for the bytes ahead of it, at worst MSG_SIZE-1 of the\n"
+           "                  longest the firmware queues\n");
+
+    printf("line busy         %lu bytes with the next one waiting, %lu late\n", busyBytes, gaps);
+    check(busyBytes > 0 && gaps == 0, "TXD idle with a byte waiting");
+
+    printf("ISR_EUSCI_A1      %lu runs, %.1f us mean %.1f us max, latency %.1f us max, %.1f%% of a frame\n",
+           simIsrTime[SRC_A1].count, simIsrTime[SRC_A1].count ? simUs(simIsrTime[SRC_A1].sum) / simIsrTime[SRC_A1].count : 0,
+           simUs(simIsrTime[SRC_A1].max), simUs(simLatency[SRC_A1].max),
+           100 * simUs(simIsrTime[SRC_A1].max) / simUs(f));
+    printf("TB3 CCR0          latency %.1f us max with the UART busy\n", simUs(simLatency[SRC_TB3_0].max));
+    printf("msgDropped        %u, the refusals and the status frames that found no room\n", msgDropped);
+
+    sendTime = sendNs();
+    drainTime = drainNs(&bytes);
+    printf("host              uartSend() %.1f ns, ISR_EUSCI_A1 %.1f ns a byte over %lu bytes\n",
+           sendTime, drainTime, bytes);
+}
+
+int main(void){
+    if(simRun(fw_main, RUN_TIME) != 0){
+        printf("FAIL: main() returned\n");
+        return 1;
+    }
+    report();
+    printf("%s, %d failed\n", failures ? "FAIL" : "PASS", failures);
+    return failures;
+}
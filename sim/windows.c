@@ -0,0 +1,226 @@
+//--------------------------------------------------------------------
+// Rolling average window of FinalProject9main.c against the old one
+//--------------------------------------------------------------------
+// Built once for each ADC_SHIFT, with the firmware built the same way.
+// oldAverage() is the adcAverage() the firmware had before the window
+// became a power of two, a modulo for the wrap and a long divide on every
+// sample, with its 20 turned into a parameter. For the window it was built
+// for this checks that averageFilter() gives exactly what the old code
+// does at the same width, every sample from reset on, over noise, steps
+// and random counts across the whole ADC range. Then it reports:
+//   ops       divides and modulos a sample, counted in oldAverage() and
+//             in newAverage(), a copy of averageFilter() checked against it
+//   time      ns a sample on this host, averageFilter() and the old code
+//             at 20
+//   old 20    against the 20 sample filter the firmware had, the mean at
+//             a steady load and the samples a step takes to get half way
+// The exit code is the number of failed checks.
+//
+//     make windows
+//--------------------------------------------------------------------
+
+#include <stdio.h>
+#include <time.h>
+
+#define ADC_WINDOW (1 << ADC_SHIFT)       // -DADC_SHIFT as for the firmware
+#define OLD_WINDOW 20
+#define SAMPLES 1048576
+#define TIMED 16777216UL
+#define NOISE 3
+
+// firmware state
+extern unsigned long int total;
+extern unsigned int index;
+extern unsigned int width;
+extern unsigned int ADC_Values[];
+unsigned int averageFilter(unsigned int value);
+
+typedef struct {
+    unsigned long total;
+    unsigned int index;
+    unsigned int width;
+    unsigned int values[64];
+    unsigned long divides;                // and modulos, counted
+    unsigned long modulos;
+} Average;
+
+static unsigned int Trace[SAMPLES];
+static unsigned long seed = 1;
+static int failures = 0;
+
+static void check(int ok, const char *what){
+    if(!ok){
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static unsigned int noise(unsigned int range){
+    seed = seed * 1103515245UL + 12345;
+    return (seed >> 16) % range;
+}
+
+static void averageReset(Average *a){
+    unsigned int n;
+
+    a->total = 0;
+    a->index = 0;
+    a->width = 0;
+    for(n=0; n<64; n++){
+        a->values[n] = 0;
+    }
+    a->divides = 0;
+    a->modulos = 0;
+}
+
+// adcAverage() as it was, window in place of 20
+static unsigned int oldAverage(Average *a, unsigned int value, unsigned int window){
+    a->total -= a->values[a->index];
+    a->values[a->index] = value;
+    a->total += a->values[a->index];
+    a->index = (a->index+1) % window;
+    a->modulos++;
+    if(a->width < window){
+        a->width++;
+    }
+    a->divides++;
+    return a->total / a->width;
+}
+
+// averageFilter() with counters
+static unsigned int newAverage(Average *a, unsigned int value){
+    a->total -= a->values[a->index];
+    a->values[a->index] = value;
+    a->total += value;
+    a->index = (a->index+1) & (ADC_WINDOW-1);
+    if(a->width < ADC_WINDOW){
+        a->width++;
+        a->divides++;
+        return a->total / a->width;
+    }
+    return a->total >> ADC_SHIFT;
+}
+
+static void firmwareReset(void){
+    unsigned int n;
+
+    for(n=0; n<ADC_WINDOW; n++){
+        ADC_Values[n] = 0;
+    }
+    total = 0;
+    index = 0;
+    width = 0;
+}
+
+// quiet, steps, ramps and anything at all in turn, 4096 samples each
+static void fill(void){
+    unsigned long n;
+    unsigned int base = 2048;
+
+    for(n=0; n<SAMPLES; n++){
+        if(n % 4096 == 0){
+            base = noise(4096 - 2*NOISE) + NOISE;
+        }
+        switch((n / 4096) % 4){
+        case 0:
+            Trace[n] = base + noise(2*NOISE+1) - NOISE;
+            break;
+        case 1:
+            Trace[n] = ((n % 512) < 256) ? base : 4095 - base;
+            break;
+        case 2:
+            Trace[n] = (n % 4096);
+            break;
+        default:
+            Trace[n] = noise(4096);
+            break;
+        }
+    }
+}
+
+static double seconds(void){
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// samples from a 1024 to 3072 step until out reaches 2048
+static unsigned int halfWay(int old){
+    static Average a;
+    unsigned int n, out;
+
+    averageReset(&a);
+    firmwareReset();
+    for(n=0; n<256; n++){
+        out = old ? oldAverage(&a, 1024, OLD_WINDOW) : averageFilter(1024);
+    }
+    for(n=0; n<256; n++){
+        out = old ? oldAverage(&a, 3072, OLD_WINDOW) : averageFilter(3072);
+        if(out >= 2048){
+            return n + 1;
+        }
+    }
+    return n;
+}
+
+int main(void){
+    static Average oldSame, counted, old20;
+    unsigned long n, mismatch = 0, firstBad = 0;
+    unsigned long long sum = 0, oldSum = 0;
+    unsigned int out, expected;
+    double start, newNs, oldNs;
+    volatile unsigned int sink = 0;
+
+    fill();
+    averageReset(&oldSame);
+    averageReset(&counted);
+    firmwareReset();
+    for(n=0; n<SAMPLES; n++){
+        out = averageFilter(Trace[n]);
+        expected = oldAverage(&oldSame, Trace[n], ADC_WINDOW);
+        if(out != expected || newAverage(&counted, Trace[n]) != out){
+            if(mismatch++ == 0){
+                firstBad = n;
+            }
+        }
+    }
+    if(mismatch){
+        printf("window %2d: %lu samples differ from the old code, the first at %lu\n",
+               ADC_WINDOW, mismatch, firstBad);
+    }
+    check(mismatch == 0, "averageFilter() isn't the old average at the same width");
+    check(counted.divides == ADC_WINDOW, "divides after the warm up");
+
+    // the old filter at 20 against this window at a steady load
+    averageReset(&old20);
+    firmwareReset();
+    seed = 5;
+    for(n=0; n<SAMPLES; n++){
+        Trace[n] = 2048 + noise(2*NOISE+1) - NOISE;
+        sum += averageFilter(Trace[n]);
+        oldSum += oldAverage(&old20, Trace[n], OLD_WINDOW);
+    }
+    check((double)sum/SAMPLES - (double)oldSum/SAMPLES < 0.5 &&
+          (double)oldSum/SAMPLES - (double)sum/SAMPLES < 0.5, "steady mean off the old filter's");
+
+    // time a sample, the trace stays in cache
+    firmwareReset();
+    start = seconds();
+    for(n=0; n<TIMED; n++){
+        sink += averageFilter(Trace[n & (SAMPLES-1)]);
+    }
+    newNs = (seconds() - start) * 1e9 / TIMED;
+    averageReset(&old20);
+    start = seconds();
+    for(n=0; n<TIMED; n++){
+        sink += oldAverage(&old20, Trace[n & (SAMPLES-1)], OLD_WINDOW);
+    }
+    oldNs = (seconds() - start) * 1e9 / TIMED;
+
+    printf("window %2d   %lu samples match the old code at %d, %lu divides and 0 modulos in all (old 20: one of each a sample)\n",
+           ADC_WINDOW, SAMPLES - mismatch, ADC_WINDOW, counted.divides);
+    printf("            %.2f ns a sample, old 20 %.2f ns; steady mean %.2f, old 20 %.2f; step half way in %u samples, old 20 %u\n",
+           newNs, oldNs, (double)sum/SAMPLES, (double)oldSum/SAMPLES, halfWay(0), halfWay(1));
+    return failures;
+}